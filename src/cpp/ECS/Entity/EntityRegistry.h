@@ -1,6 +1,7 @@
 #pragma once
 
 #include <tbb/tbb.h>
+#include <memory/small_vector.h>
 #include "MetadataProvider.h"
 #include "ECS/Component/ComponentRegistry.h"
 #include "ECS/Component/Types/AbstractComponentType.h"
@@ -11,7 +12,7 @@ class EntityReference;
 struct EntityCreator {
     EntityID next{};
     EntityID cap{};
-    std::vector<Entity> ids;
+    mem::small_vector<Entity, 16> ids;
 
     bool hasEntity() const {
         return next != cap || !ids.empty();
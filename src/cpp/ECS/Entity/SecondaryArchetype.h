@@ -3,6 +3,7 @@
 #include <memory/type_info.h>
 #include <memory/byte_arena.h>
 #include <memory/free_list_allocator.h>
+#include <memory/small_vector.h>
 #include "ECS/Component/Types/PrimaryKindRegistry.h"
 
 struct ArchetypeYieldType {
@@ -21,7 +22,7 @@ struct SecondaryEntityLocation {
 };
 
 struct SecondaryEntityMetadata {
-    mem::vector<SecondaryEntityLocation, mem::free_list_adaptor<SecondaryEntityLocation>> location;
+    mem::small_vector<SecondaryEntityLocation, 3, mem::free_list_adaptor<SecondaryEntityLocation>> location;
 
     SecondaryEntityMetadata(mem::free_list_allocator* alloc) : location(alloc) {}
 
@@ -4,6 +4,7 @@
 #include <tbb/tbb.h>
 #include <unordered_map>
 #include <memory/vector.h>
+#include <memory/telemetry.h>
 
 struct ThreadLocalChunk {
     struct Free {
@@ -55,10 +56,12 @@ struct ThreadLocalChunk {
 
 class ThreadAllocator {
     tbb::enumerable_thread_specific<ThreadLocalChunk> threads;
+    MEM_NO_UNIQUE_ADDRESS mem::allocator_telemetry telemetry{"ThreadAllocator"};
 public:
     ThreadAllocator() = default;
     
     void* allocate(const mem::type_info* type, size_t count) {
+        telemetry.record_allocation(mem::typeindex(type).size() * count);
         return threads.local().allocator.allocate(type, count);
     }
 
@@ -76,5 +79,17 @@ public:
         for (auto& thread : threads) {
             thread.merge();
         }
+
+        if constexpr (mem::is_telemetry_enabled) {
+            mem::allocator_usage usage;
+            for (auto& thread : threads) {
+                usage += thread.allocator.usage();
+            }
+            telemetry.end_frame(usage);
+        }
+    }
+
+    mem::allocator_stats stats() const {
+        return telemetry.stats();
     }
 };
\ No newline at end of file
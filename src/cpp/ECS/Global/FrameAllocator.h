@@ -4,6 +4,7 @@
 #include <tbb/tbb.h>
 #include <memory/vector.h>
 #include <memory/memory.h>
+#include <memory/telemetry.h>
 
 struct ThreadFrameLocalChunk {
     struct AllocationHeader {
@@ -12,6 +13,7 @@ struct ThreadFrameLocalChunk {
         size_t len;
     };
     mem::byte_arena<> arena = mem::create_byte_arena(mem::megabyte(0.1).bytes());
+    mem::high_water_mark highWater{mem::megabyte(0.1).bytes()};
     mem::vector<AllocationHeader> allocations;
 
     void* allocate(mem::typeindex type, size_t count) {
@@ -27,11 +29,12 @@ struct ThreadFrameLocalChunk {
     ThreadFrameLocalChunk() {}
 
     ThreadFrameLocalChunk(ThreadFrameLocalChunk&& other) noexcept :
-    arena(std::move(other.arena)), allocations(std::move(other.allocations)) {}
+    arena(std::move(other.arena)), highWater(other.highWater), allocations(std::move(other.allocations)) {}
 
     ThreadFrameLocalChunk& operator = (ThreadFrameLocalChunk&& other) noexcept {
         if (this != &other) {
             arena = std::move(other.arena);
+            highWater = other.highWater;
             allocations = std::move(other.allocations);
         }
         return *this;
@@ -45,7 +48,7 @@ struct ThreadFrameLocalChunk {
         for (auto& [type, ptr, len] : allocations) {
             type.destroy(ptr, len);
         }
-        arena.reset_compact();
+        arena.reset_presized(highWater.sample(arena.bytes_used()));
         allocations.clear();
     }
 
@@ -65,11 +68,12 @@ enum class FrameAllocationType {
 
 class FrameAllocator {
     tbb::enumerable_thread_specific<ThreadFrameLocalChunk> threads;
-
+    MEM_NO_UNIQUE_ADDRESS mem::allocator_telemetry telemetry{"FrameAllocator"};
 public:
     FrameAllocator() = default;
 
     void* allocate(mem::typeindex type, size_t count) {
+        telemetry.record_allocation(type.size() * count);
         return threads.local().allocate(type, count);
     }
 
@@ -85,14 +89,27 @@ public:
     }
 
     void* allocateUnmanaged(mem::typeindex type, const size_t count) {
+        telemetry.record_allocation(type.size() * count);
         return threads.local().allocateUnmanaged(type, count);
     }
 
     void reset() {
+        if constexpr (mem::is_telemetry_enabled) {
+            mem::allocator_usage usage;
+            for (auto& thread : threads) {
+                usage += thread.arena.usage();
+            }
+            telemetry.end_frame(usage);
+        }
+
         for (auto& thread : threads) {
             thread.reset();
         }
     }
+
+    mem::allocator_stats stats() const {
+        return telemetry.stats();
+    }
 };
 
 template <typename T>
@@ -1,6 +1,7 @@
 #pragma once
 #include <ECS/Component/TypeUUID.h>
 #include <ECS/System/RuntimeSystemDescriptor.h>
+#include <memory/small_vector.h>
 
 struct SystemGraph {
     struct Node {
@@ -8,7 +9,7 @@ struct SystemGraph {
         UpdateSystemDescriptor* descriptor{};
         void* instance = nullptr;
     };
-    mem::vector<Node> nodes;
+    mem::small_vector<Node, 8> nodes;
 
     void addSystem(TypeUUID system, UpdateSystemDescriptor* descriptor, void* instance) {
         nodes.emplace_back(system, descriptor, instance);
@@ -0,0 +1,30 @@
+#include "BoundingVolumeHierarchy.h"
+#include "LinearBoundingVolumeHierarchy.h"
+#include <vector>
+
+/* both hierarchies are header only, instantiating them over boxes keeps every builder and query compiling with Math */
+template class BoundingVolumeHierarchy<AABB>;
+template class LinearBoundingVolumeHierarchy<AABB>;
+
+namespace {
+    [[maybe_unused]] void instantiateQueries(std::vector<AABB>& boxes, const Ray& ray, const RayPacket& packet, BVHRayResult<AABB>* hits) {
+        const auto anyHit = [](const auto&) { return false; };
+
+        BVH<AABB> bvh(boxes, 4);
+        bvh.forEachIntersects(bvh.bounds(), anyHit);
+        bvh.forEachRayIntersects(ray, anyHit);
+        bvh.forEachRayIntersects(ray, glm::mat4(1.0f), anyHit);
+        bvh.forEachNode([](const BVH<AABB>::BVHNode&) {});
+
+        LinearBVH<AABB> linear;
+        linear.build(boxes, 4);
+        linear.buildMorton(boxes, 4);
+        linear.flatten(bvh);
+        linear.forEachIntersects(linear.bounds(), anyHit);
+        linear.forEachRayIntersects(ray, anyHit);
+        linear.forEachRayIntersects(ray, glm::mat4(1.0f), anyHit);
+        linear.forEachPacketIntersects(packet, [](unsigned, const BVHRayResult<AABB>&) { return false; });
+        linear.intersectClosest(packet, hits);
+        linear.forEachNode([](const LinearBVHNode&) {});
+    }
+}
@@ -1,13 +1,20 @@
 #pragma once
-#include "Shapes/Triangle.h"
 #include "Shapes/AABB.h"
 #include "Shapes/geom.h"
 #include <algorithm>
+#include <cfloat>
 #include <stack>
 #include <memory/Span.h>
 #include "Shapes/Ray.h"
 #include <memory/vector.h>
 #include <memory/byte_arena.h>
+#include <deque>
+#include <vector>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/enumerable_thread_specific.h>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_invoke.h>
+#include <oneapi/tbb/parallel_reduce.h>
 
 template <typename Primitive>
 struct BVHRayResult : public RayResult {
@@ -16,25 +23,22 @@ struct BVHRayResult : public RayResult {
 
 template <typename T>
 struct BVH_Primitive_Type {
-    using primitive_type = std::conditional_t<
-        std::constructible_from<AABB, T>, AABB,
-        std::conditional_t<
-            std::constructible_from<Triangle, T>, Triangle,
-            void
-        >
-    >;
+    using primitive_type = std::conditional_t<std::constructible_from<AABB, T>, AABB, void>;
 };
 
 template <typename T>
 using primitive_type_t = BVH_Primitive_Type<T>::primitive_type;
 
 template <typename Primitive> requires (!std::is_same_v<primitive_type_t<Primitive>, void>)
-// Primitive requires an operator const Geom&() where Geom: AABB or Triangle
+// Primitive requires an operator const AABB&()
 class BoundingVolumeHierarchy {
 public:
     using const_ref_primitive_type_t = const primitive_type_t<Primitive>&;
     using primitive_arena = mem::byte_arena<mem::same_alloc_schema, alignof(Primitive)>;
     using primitive_vector = mem::vector<Primitive, mem::byte_arena_adaptor<Primitive, primitive_arena>>;
+    /* stable name of a primitive handed out by build and insert, kept by refits and rebuilds until the next build or clear */
+    using Handle = uint32_t;
+    using handle_vector = mem::vector<Handle, mem::byte_arena_adaptor<Handle, primitive_arena>>;
 
     static const_ref_primitive_type_t primitive_cast(const Primitive& primitive) {
         return static_cast<const_ref_primitive_type_t>(primitive);
@@ -46,9 +50,17 @@ public:
         BVHNode* left = nullptr;
         BVHNode* right = nullptr;
         primitive_vector primitives;
+        /* handles of primitives, slot for slot */
+        handle_vector handles;
+        /* primitives below this node and their SAH cost relative to its area, builtCost is the cost when the subtree was built */
+        size_t count = 0;
+        float cost = 0.0f;
+        float builtCost = 0.0f;
+        bool dirty = false;
+        bool released = false;
 
         BVHNode() = default;
-        BVHNode(auto& arena) : primitives(&arena) {}
+        BVHNode(auto& arena) : primitives(&arena), handles(&arena) {}
 
         bool isLeaf() const {
             return !left;
@@ -68,6 +80,7 @@ public:
             if (forEachIntersects(aabb, std::forward<CB>(cb), node->left)) return true;
             if (forEachIntersects(aabb, std::forward<CB>(cb), node->right)) return true;
         }
+        return false;
     }
 
     template <bool Transform, typename Callable>
@@ -101,114 +114,467 @@ public:
             if (forEachRayIntersects<Transform>(ray, bvhWorldTransform, normalMatrix, callable, node->left)) return true;
             return forEachRayIntersects<Transform>(ray, bvhWorldTransform, normalMatrix, callable, node->right);
         }
+        return false;
     }
 
-    AABB computeCentroidBounds(Primitive* primitives, const size_t start, const size_t end) {
+    /* primitives at or above this count bin, bound and partition in parallel, smaller ranges stay serial */
+    constexpr static size_t PARALLEL_THRESHOLD = 16 * 1024;
+    /* subtrees at or above this count are built as separate tasks */
+    constexpr static size_t TASK_THRESHOLD = 2 * 1024;
+
+    /* min/max accumulator, merging in any order gives the exact same result, which keeps parallel builds deterministic */
+    struct Extent {
         glm::vec3 min = glm::vec3(FLT_MAX);
         glm::vec3 max = glm::vec3(-FLT_MAX);
 
-        for (auto i = start; i < end; ++i) {
-            auto& primitive = primitives[i];
-            glm::vec3 centroid = geom::centroid(primitive_cast(primitive));
+        void add(const glm::vec3 point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void add(const AABB& aabb) {
+            min = glm::min(min, aabb.min());
+            max = glm::max(max, aabb.max());
+        }
 
-            if (centroid.x < min.x) min.x = centroid.x;
-            if (centroid.y < min.y) min.y = centroid.y;
-            if (centroid.z < min.z) min.z = centroid.z;
+        void add(const Extent& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        float surfaceArea() const {
+            const glm::vec3 e = max - min;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.x * e.z);
+        }
 
-            if (centroid.x > max.x) max.x = centroid.x;
-            if (centroid.y > max.y) max.y = centroid.y;
-            if (centroid.z > max.z) max.z = centroid.z;
+        AABB toAABB() const {
+            return AABB::fromTo(min, max);
         }
-        return AABB::fromTo(min, max);
+    };
+
+    /* fn(size_t begin, size_t end, T& acc) over [start, end), split into tbb tasks for large ranges */
+    template <typename T, typename Fn>
+    static T reduce(const size_t start, const size_t end, const bool parallel, Fn&& fn) {
+        if (!parallel || end - start < PARALLEL_THRESHOLD) {
+            T acc{};
+            fn(start, end, acc);
+            return acc;
+        }
+        return tbb::parallel_reduce(tbb::blocked_range<size_t>(start, end, PARALLEL_THRESHOLD / 4), T{},
+            [&](const tbb::blocked_range<size_t>& range, T acc) {
+                fn(range.begin(), range.end(), acc);
+                return acc;
+            },
+            [](T lhs, const T& rhs) {
+                lhs.add(rhs);
+                return lhs;
+            });
     }
-private:
-    static size_t reserveForNodes(const size_t forNodes, const size_t maxLeafSize) {
-        return 3 * static_cast<size_t>(ceil(forNodes / maxLeafSize + 1)) + 1;
+
+    static Extent centroidExtent(const Primitive* primitives, const size_t start, const size_t end, const bool parallel = false) {
+        return reduce<Extent>(start, end, parallel, [&](const size_t begin, const size_t last, Extent& acc) {
+            for (size_t i = begin; i < last; ++i) {
+                acc.add(geom::centroid(primitive_cast(primitives[i])));
+            }
+        });
     }
 
-    BVHNode* build(Primitive* primitives, const size_t start, const size_t end, const size_t maxLeafSize, BVHNode* parent = nullptr) {
-        BVHNode* node = &nodes.emplace_back();
-        node->bounds = primitives[start];
-        node->parent = parent;
+    static Extent boundsExtent(const Primitive* primitives, const size_t start, const size_t end, const bool parallel = false) {
+        return reduce<Extent>(start, end, parallel, [&](const size_t begin, const size_t last, Extent& acc) {
+            for (size_t i = begin; i < last; ++i) {
+                acc.add(static_cast<const AABB&>(primitives[i]));
+            }
+        });
+    }
+
+    static AABB computeCentroidBounds(const Primitive* primitives, const size_t start, const size_t end) {
+        return centroidExtent(primitives, start, end).toAABB();
+    }
 
-        for (auto i = start + 1; i < end; ++i) {
-            node->bounds = geom::merge(node->bounds, primitives[i]);
+    static AABB computeBounds(const Primitive* primitives, const size_t start, const size_t end) {
+        return boundsExtent(primitives, start, end).toAABB();
+    }
+
+    /**
+     * Moves every primitive matching pred in front of the rest and returns the partition point.
+     * Large ranges use a stable partition: its result is unique, so the chunked parallel version
+     * and std::stable_partition agree element for element
+     */
+    template <typename Pred>
+    static size_t partition(Primitive* primitives, const size_t start, const size_t end, const bool parallel, Pred&& pred) {
+        static_assert(std::is_trivially_copyable_v<Primitive>, "the parallel scatter copies primitives with memcpy");
+        const size_t count = end - start;
+
+        if (count < PARALLEL_THRESHOLD) {
+            return std::partition(primitives + start, primitives + end, pred) - primitives;
+        }
+        if (!parallel) {
+            return std::stable_partition(primitives + start, primitives + end, pred) - primitives;
         }
 
-        size_t count = end - start;
-        if (count <= maxLeafSize) {
-            node->primitives = mem::make_vector_like<primitive_vector>(
-                primitives + start, count, count,
-                mem::make_byte_arena_adaptor<Primitive>(primitivesArena)
-            );
-            return node;
+        constexpr size_t chunk = PARALLEL_THRESHOLD / 4;
+        const size_t chunks = (count + chunk - 1) / chunk;
+
+        std::vector<size_t> before(chunks + 1, 0);
+        tbb::parallel_for(size_t(0), chunks, [&](const size_t c) {
+            const size_t first = start + c * chunk;
+            const size_t last = std::min(first + chunk, end);
+            before[c + 1] = std::count_if(primitives + first, primitives + last, pred);
+        });
+        for (size_t c = 0; c < chunks; ++c) {
+            before[c + 1] += before[c];
         }
+        const size_t matching = before[chunks];
+
+        std::allocator<Primitive> allocator;
+        Primitive* scratch = allocator.allocate(count);
+
+        tbb::parallel_for(size_t(0), chunks, [&](const size_t c) {
+            const size_t first = start + c * chunk;
+            const size_t last = std::min(first + chunk, end);
 
-        AABB centroidBounds = computeCentroidBounds(primitives, start, end);
-        glm::vec3 extent = centroidBounds.max() - centroidBounds.min();
+            size_t left = before[c];
+            size_t right = matching + (first - start) - before[c];
+
+            for (size_t i = first; i < last; ++i) {
+                std::memcpy(scratch + (pred(primitives[i]) ? left++ : right++), primitives + i, sizeof(Primitive));
+            }
+        });
+        std::memcpy(primitives + start, scratch, count * sizeof(Primitive));
+        allocator.deallocate(scratch, count);
+
+        return start + matching;
+    }
+
+    /**
+     * Bucketed SAH split of [start, end) along the widest centroid axis, partitions primitives in place.
+     * Returns the first primitive of the right half, or end when a leaf is cheaper than any split.
+     * Shared by every builder so the pointer and the linear hierarchy split identically,
+     * parallel only changes how the bins are filled, never which split is chosen
+     */
+    static size_t splitSAH(Primitive* primitives, const size_t start, const size_t end, const AABB& bounds, int* splitAxis = nullptr, const bool parallel = false) {
+        const size_t count = end - start;
+        const Extent centroids = centroidExtent(primitives, start, end, parallel);
+        const glm::vec3 extent = centroids.max - centroids.min;
 
         int axis = 0;
         if (extent.y > extent.x) axis = 1;
         if (extent.z > extent[axis]) axis = 2;
 
+        if (splitAxis) *splitAxis = axis;
+
         constexpr int bucketCount = 12;
 
-        struct BucketInfo {
-            int count = 0;
-            AABB bounds;
+        const auto bucketOf = [&](const Primitive& p) {
+            const float centroidAxis = geom::centroid(primitive_cast(p))[axis];
+            int b = static_cast<int>(bucketCount * (centroidAxis - centroids.min[axis]) / (extent[axis] + 1e-5f));
+            if (b == bucketCount) b = bucketCount - 1;
+            return b;
         };
-        BucketInfo buckets[bucketCount];
 
-        for (size_t i = start; i < end; ++i) {
-            float centroidAxis = geom::centroid(primitives[i])[axis];
-            int b = static_cast<int>(bucketCount * (centroidAxis - centroidBounds.min()[axis]) / (extent[axis] + 1e-5f));
-            if (b == bucketCount) b = bucketCount - 1;
-            ++buckets[b].count;
-            buckets[b].bounds = geom::merge(buckets[b].bounds, primitives[i]);
+        struct Buckets {
+            size_t count[bucketCount]{};
+            Extent bounds[bucketCount]{};
+
+            void add(const Buckets& other) {
+                for (int b = 0; b < bucketCount; ++b) {
+                    count[b] += other.count[b];
+                    bounds[b].add(other.bounds[b]);
+                }
+            }
+        };
+
+        const Buckets buckets = reduce<Buckets>(start, end, parallel, [&](const size_t begin, const size_t last, Buckets& acc) {
+            for (size_t i = begin; i < last; ++i) {
+                const int b = bucketOf(primitives[i]);
+                ++acc.count[b];
+                acc.bounds[b].add(static_cast<const AABB&>(primitives[i]));
+            }
+        });
+
+        // sweep the prefix and suffix once instead of re-merging both sides for every split
+        Extent prefix[bucketCount], suffix[bucketCount];
+        size_t prefixCount[bucketCount], suffixCount[bucketCount];
+
+        for (int i = 0; i < bucketCount; ++i) {
+            prefix[i] = i ? prefix[i - 1] : Extent{};
+            prefix[i].add(buckets.bounds[i]);
+            prefixCount[i] = (i ? prefixCount[i - 1] : 0) + buckets.count[i];
+
+            const int j = bucketCount - 1 - i;
+            suffix[j] = i ? suffix[j + 1] : Extent{};
+            suffix[j].add(buckets.bounds[j]);
+            suffixCount[j] = (i ? suffixCount[j + 1] : 0) + buckets.count[j];
         }
+
+        const float area = geom::surface_area(bounds);
         float minCost = std::numeric_limits<float>::max();
         int minCostSplit = -1;
 
         for (int i = 1; i < bucketCount; ++i) {
-            AABB b0, b1;
-            int count0 = 0, count1 = 0;
-
-            for (int j = 0; j < i; ++j) {
-                b0 = geom::merge(b0, buckets[j].bounds);
-                count0 += buckets[j].count;
-            }
-            for (int j = i; j < bucketCount; ++j) {
-                b1 = geom::merge(b1, buckets[j].bounds);
-                count1 += buckets[j].count;
-            }
+            const float area0 = prefixCount[i - 1] ? prefix[i - 1].surfaceArea() : 0.0f;
+            const float area1 = suffixCount[i] ? suffix[i].surfaceArea() : 0.0f;
 
-            float cost = 1 + (count0 * geom::surface_area(b0) + count1 * geom::surface_area(b1)) / geom::surface_area(node->bounds);
+            float cost = 1 + (prefixCount[i - 1] * area0 + suffixCount[i] * area1) / area;
             if (cost < minCost) {
                 minCost = cost;
                 minCostSplit = i;
             }
         }
         if (minCost >= count) {
+            return end;
+        }
+
+        const size_t mid = partition(primitives, start, end, parallel, [&](const Primitive& p) {
+            return bucketOf(p) < minCostSplit;
+        });
+        return mid == start ? end : mid;
+    }
+
+    /* split tree of a build, the same for every builder and independent of how many threads produced it */
+    struct BuildNode {
+        AABB bounds;
+        size_t start = 0;
+        size_t end = 0;
+        BuildNode* left = nullptr;
+        BuildNode* right = nullptr;
+        int axis = 0;
+
+        bool isLeaf() const {
+            return !left;
+        }
+    };
+
+    /* owns the BuildNodes of one build, tasks allocate from their thread's deque so addresses stay stable */
+    class BuildArena {
+        tbb::enumerable_thread_specific<std::deque<BuildNode>> nodes;
+    public:
+        BuildNode& make() {
+            return nodes.local().emplace_back();
+        }
+    };
+
+    /**
+     * Recursive SAH build of [start, end) into arena, reorders primitives.
+     * With parallel, subtrees of TASK_THRESHOLD primitives or more run as tbb tasks and large nodes
+     * bin in parallel. The resulting tree and primitive order do not depend on parallel
+     */
+    static BuildNode* buildSplits(BuildArena& arena, Primitive* primitives, const size_t start, const size_t end, const size_t maxLeafSize, const bool parallel) {
+        BuildNode& node = arena.make();
+        node.bounds = boundsExtent(primitives, start, end, parallel).toAABB();
+        node.start = start;
+        node.end = end;
+
+        const size_t count = end - start;
+        const size_t mid = count <= maxLeafSize ? end : splitSAH(primitives, start, end, node.bounds, &node.axis, parallel);
+        if (mid == end) {
+            return &node;
+        }
+
+        if (parallel && count >= TASK_THRESHOLD) {
+            tbb::parallel_invoke(
+                [&] { node.left = buildSplits(arena, primitives, start, mid, maxLeafSize, parallel); },
+                [&] { node.right = buildSplits(arena, primitives, mid, end, maxLeafSize, parallel); }
+            );
+        } else {
+            node.left = buildSplits(arena, primitives, start, mid, maxLeafSize, parallel);
+            node.right = buildSplits(arena, primitives, mid, end, maxLeafSize, parallel);
+        }
+        return &node;
+    }
+    /* levels with fewer dirty nodes than this are refit on the calling thread */
+    constexpr static size_t REFIT_GRAIN = 256;
+
+    /* a primitive with its handle, builds run over these so the handles follow the SAH reordering */
+    struct Tracked {
+        Primitive primitive;
+        Handle handle;
+
+        operator const_ref_primitive_type_t() const {
+            return primitive_cast(primitive);
+        }
+    };
+    using Tracker = BoundingVolumeHierarchy<Tracked>;
+private:
+    /* where a handle lives, updated whenever a leaf is emitted */
+    struct Location {
+        BVHNode* leaf = nullptr;
+        uint32_t slot = 0;
+    };
+
+    /* uninitialized tracked primitives for one build, they are trivially copyable so nothing is constructed */
+    class TrackedScratch {
+        std::allocator<Tracked> allocator;
+        size_t count;
+    public:
+        Tracked* data;
+
+        explicit TrackedScratch(const size_t count) : count(count), data(allocator.allocate(count)) {}
+
+        TrackedScratch(const TrackedScratch&) = delete;
+        TrackedScratch& operator=(const TrackedScratch&) = delete;
+
+        ~TrackedScratch() {
+            allocator.deallocate(data, count);
+        }
+    };
+
+    /* arena bytes for count primitives spread over leaves, every leaf may pad its primitive run */
+    static size_t arenaBytesFor(const size_t count) {
+        return count * (sizeof(Primitive) + sizeof(Handle) + alignof(Primitive));
+    }
+
+    static float surfaceArea(const AABB& aabb) {
+        return std::max(geom::surface_area(aabb), FLT_MIN);
+    }
+
+    /* same cost model as splitSAH: a leaf costs its primitive count, an interior node one traversal step plus its children by area */
+    static void updateStats(BVHNode* node) {
+        if (node->isLeaf()) {
+            node->count = node->primitives.size();
+            node->cost = static_cast<float>(node->count);
+            return;
+        }
+        node->count = node->left->count + node->right->count;
+        node->cost = 1.0f + (surfaceArea(node->left->bounds) * node->left->cost + surfaceArea(node->right->bounds) * node->right->cost) / surfaceArea(node->bounds);
+    }
+
+    static void refitNode(BVHNode* node) {
+        if (node->isLeaf()) {
+            if (!node->primitives.empty()) {
+                Extent extent;
+                for (const auto& primitive : node->primitives) {
+                    extent.add(static_cast<const AABB&>(primitive));
+                }
+                node->bounds = extent.toAABB();
+            }
+        } else {
+            node->bounds = geom::merge(node->left->bounds, node->right->bounds);
+        }
+        updateStats(node);
+        node->dirty = false;
+    }
+
+    /* released nodes stay in the deque and are handed out again before it grows, so node addresses never change */
+    BVHNode* allocateNode() {
+        if (!freeNodes.empty()) {
+            BVHNode* node = freeNodes.back();
+            freeNodes.pop_back();
+            *node = BVHNode(primitivesArena);
+            return node;
+        }
+        return &nodes.emplace_back(primitivesArena);
+    }
+
+    void releaseNode(BVHNode* node) {
+        node->primitives.clear();
+        node->handles.clear();
+        node->left = node->right = node->parent = nullptr;
+        node->released = true;
+        freeNodes.push_back(node);
+    }
+
+    /**
+     * Writes split into node and allocates its descendants depth first, left before right, on the calling thread.
+     * Every leaf copies its primitives and handles to its own arena runs and records where each handle went
+     */
+    template <typename Split>
+    void emit(BVHNode* node, const Split* split, const Tracked* tracked, BVHNode* parent) {
+        node->bounds = split->bounds;
+        node->parent = parent;
+        node->dirty = false;
+
+        if (split->isLeaf()) {
+            const size_t count = split->end - split->start;
+            Primitive* primitives = primitivesArena.template allocate<Primitive>(count);
+            Handle* handles = primitivesArena.template allocate<Handle>(count);
+
+            for (size_t i = 0; i < count; ++i) {
+                const Tracked& item = tracked[split->start + i];
+                primitives[i] = item.primitive;
+                handles[i] = item.handle;
+                locations[item.handle] = Location{node, static_cast<uint32_t>(i)};
+            }
+            node->left = node->right = nullptr;
             node->primitives = mem::make_vector_like<primitive_vector>(
-                primitives + start, count, count, /* this was the end-start */
+                primitives, count, count,
                 mem::make_byte_arena_adaptor<Primitive>(primitivesArena)
             );
-            return node;
+            node->handles = mem::make_vector_like<handle_vector>(
+                handles, count, count,
+                mem::make_byte_arena_adaptor<Handle>(primitivesArena)
+            );
+        } else {
+            node->left = allocateNode();
+            emit(node->left, split->left, tracked, node);
+            node->right = allocateNode();
+            emit(node->right, split->right, tracked, node);
         }
+        updateStats(node);
+        node->builtCost = node->cost;
+    }
 
-        auto midIter = std::partition(primitives + start, primitives + end,
-            [&](const Primitive& p) {
-                const float centroidAxis = geom::centroid(primitive_cast(p))[axis];
-                int b = static_cast<int>(bucketCount * (centroidAxis - centroidBounds.min()[axis]) / (extent[axis] + 1e-5f));
-                if (b == bucketCount) b = bucketCount - 1;
-                return b < minCostSplit;
-            });
+    /* builds over tracked, which is reordered, every primitive keeps the handle it carries */
+    BVHNode* build(Tracked* tracked, const size_t count, const size_t maxLeafSize, const bool parallel = true) {
+        leafSize = maxLeafSize;
 
-        size_t mid = midIter - primitives;
+        typename Tracker::BuildArena arena;
+        BVHNode* root = allocateNode();
+        emit(root, Tracker::buildSplits(arena, tracked, 0, count, maxLeafSize, parallel), tracked, nullptr);
+        return root;
+    }
+
+    /* copies the primitives below node and their handles to out in depth first order, returns the end of the written range */
+    static Tracked* gather(const BVHNode* node, Tracked* out) {
+        if (node->isLeaf()) {
+            for (size_t i = 0; i < node->primitives.size(); ++i) {
+                *out++ = Tracked{node->primitives[i], node->handles[i]};
+            }
+            return out;
+        }
+        return gather(node->right, gather(node->left, out));
+    }
+
+    /* frees everything below node, node itself is kept */
+    void releaseChildren(BVHNode* node) {
+        if (node->isLeaf()) return;
+
+        releaseChildren(node->left);
+        releaseChildren(node->right);
+        releaseNode(node->left);
+        releaseNode(node->right);
+    }
+
+    /**
+     * Rebuilds the subtree in place with the SAH builder, node keeps its address and parent.
+     * The new leaves get fresh arena runs, the old runs are counted as dead until compact reclaims them
+     */
+    void rebuildSubtree(BVHNode* node, const bool parallel) {
+        const size_t count = node->count;
+        TrackedScratch scratch(count);
+        gather(node, scratch.data);
+        releaseChildren(node);
+        deadPrimitives += count;
+
+        typename Tracker::BuildArena arena;
+        emit(node, Tracker::buildSplits(arena, scratch.data, 0, count, leafSize, parallel), scratch.data, node->parent);
+
+        for (BVHNode* parent = node->parent; parent; parent = parent->parent) {
+            updateStats(parent);
+        }
+    }
+
+    /* full rebuild into a single arena block, drops every dead run. Handles stay valid, node addresses do not */
+    void compact(const bool parallel) {
+        TrackedScratch scratch(primitiveCount);
+        gather(_root, scratch.data);
 
-        node->left = build(primitives, start, mid, maxLeafSize, node);
-        node->right = build(primitives, mid, end, maxLeafSize, node);
-        return node;
+        nodes.clear();
+        freeNodes.clear();
+        primitivesArena.reset_compact();
+        deadPrimitives = 0;
+
+        _root = build(scratch.data, primitiveCount, leafSize, parallel);
     }
 
     static void replaceChild(BVHNode* parent, BVHNode* oldChild, BVHNode* newChild) {
@@ -247,107 +613,110 @@ private:
         return best;
     }
 
-    mem::vector<BVHNode> nodes;
+    std::deque<BVHNode> nodes;
+    std::vector<BVHNode*> freeNodes;
+    std::vector<BVHNode*> dirtyLeaves;
+    std::vector<std::vector<BVHNode*>> refitLevels;
+    /* indexed by handle */
+    std::vector<Location> locations;
+    size_t leafSize = 4;
     size_t primitiveCount = 0;
+    /* primitives in arena runs that no leaf points to anymore */
+    size_t deadPrimitives = 0;
     primitive_arena primitivesArena;
     BVHNode* _root = nullptr;
 public:
     BoundingVolumeHierarchy() = default;
 
     template <typename Range>
-    BoundingVolumeHierarchy(Range&& range, const size_t maxLeafSize) {
-        build(range, maxLeafSize);
+    BoundingVolumeHierarchy(Range&& range, const size_t maxLeafSize, const bool parallel = true) {
+        build(range, maxLeafSize, parallel);
     }
 
     BoundingVolumeHierarchy(mem::range<Primitive> primitives, const size_t maxLeafSize) {
         build(primitives, maxLeafSize);
     }
 
+    /**
+     * Parallel builds produce exactly the tree a serial build of the same input does.
+     * The primitive at index i of the range gets handle i
+     */
     template <typename Range>
-    void build(Range&& primitives, const size_t maxLeafSize) {
+    void build(Range&& primitives, const size_t maxLeafSize, const bool parallel = true) {
         if (_root) {
             clear();
         }
-        if (!primitivesArena.has_for(mem::type_info_of<Primitive>, primitives.size())) {
-            primitivesArena.initialize(mem::type_info_of<Primitive>, primitives.size());
+        const size_t size = primitives.size();
+        if (!primitivesArena.has_for(mem::type_info_of<char>, arenaBytesFor(size))) {
+            primitivesArena.initialize(arenaBytesFor(size));
         }
 
-        nodes = reserveForNodes(primitives.size(), maxLeafSize);
-
-        auto ptr = primitivesArena.allocate<Primitive>(primitives.size());
-
-        if constexpr (std::is_trivially_copyable_v<Primitive>) {
-            memcpy(ptr, primitives.data(), sizeof(Primitive) * primitives.size());
-        } else {
-            static_assert(false, "Not supported yet or never");
+        TrackedScratch scratch(size);
+        for (size_t i = 0; i < size; ++i) {
+            scratch.data[i] = Tracked{primitives.data()[i], static_cast<Handle>(i)};
         }
-        _root = build(ptr, 0, primitives.size(), maxLeafSize);
+        locations.resize(size);
+        _root = build(scratch.data, size, maxLeafSize, parallel);
+        primitiveCount = size;
     }
 
+    /* every primitive keeps its handle in the new hierarchy */
     BoundingVolumeHierarchy rebuild(const size_t maxLeafSize, const size_t extraPrimitives = 0) {
         const size_t size = this->primitiveCount;
-        const size_t capacity = size + extraPrimitives;
         BoundingVolumeHierarchy bvh;
+        bvh.primitivesArena.initialize(arenaBytesFor(size + extraPrimitives));
 
-        bvh.primitivesArena.initialize(mem::type_info_of<Primitive>, capacity);
-        bvh.nodes.reserve(reserveForNodes(capacity, maxLeafSize));
-        auto ptr = bvh.primitivesArena.template allocate_or_fail<Primitive>(size);
-
-        cexpr::require(ptr);
+        TrackedScratch scratch(size);
+        if (_root) gather(_root, scratch.data);
 
-        if constexpr (std::is_trivially_copyable_v<Primitive>) {
-            primitivesArena.copy_all_memory_to(ptr, mem::type_info_of<Primitive>);
-        } else {
-            static_assert(false, "Not supported yet or never");
-        }
-        bvh._root = bvh.build(ptr, 0, size, maxLeafSize);
+        bvh.locations.resize(locations.size());
+        bvh._root = bvh.build(scratch.data, size, maxLeafSize);
         bvh.primitiveCount = size;
         return std::move(bvh);
     }
 
+    /* existing primitives keep their handles, primitives[i] gets the i-th handle after them */
     BoundingVolumeHierarchy rebuildWith(mem::range<Primitive> primitives, const size_t maxLeafSize) {
         const size_t size = primitives.size() + primitiveCount;
-
         BoundingVolumeHierarchy bvh;
-        bvh.primitivesArena.initialize(mem::type_info_of<Primitive>, size);
-        auto ptr = bvh.primitivesArena.template allocate_or_fail<Primitive>(size);
-
-        cexpr::require(ptr);
+        bvh.primitivesArena.initialize(arenaBytesFor(size));
 
-        if constexpr (std::is_trivially_copyable_v<Primitive>) {
-            void* remaining = primitivesArena.copy_all_memory_to(ptr, mem::type_info_of<Primitive>);
-            mem::copy(mem::type_info_of<Primitive>, remaining, primitives.data(), primitives.size());
-        } else {
-            static_assert(false, "Not supported yet or never");
+        TrackedScratch scratch(size);
+        Tracked* remaining = _root ? gather(_root, scratch.data) : scratch.data;
+        for (size_t i = 0; i < primitives.size(); ++i) {
+            remaining[i] = Tracked{primitives.data()[i], static_cast<Handle>(locations.size() + i)};
         }
-        bvh._root = bvh.build(ptr, 0, size, maxLeafSize);
+
+        bvh.locations.resize(locations.size() + primitives.size());
+        bvh._root = bvh.build(scratch.data, size, maxLeafSize);
         bvh.primitiveCount = size;
         return std::move(bvh);
     }
 
-    void insert(const Primitive& primitive) {
-        if (nodes.size() + 2 >= nodes.capacity()) {
-            const size_t newCapacity = std::max(nodes.capacity() * 2, 16ull);
-            nodes.reserve(newCapacity);
-            primitivesArena.reserve(newCapacity * sizeof(Primitive));
-        }
-        insert(_root, primitive, primitive);
+    Handle insert(const Primitive& primitive) {
+        const Handle handle = insert(_root, primitive, primitive);
         ++primitiveCount;
+        return handle;
     }
 
-    void insert(BVHNode*& root, const AABB& newBounds, const Primitive& payload) {
-        BVHNode* leaf = &nodes.emplace_back(primitivesArena);
+    Handle insert(BVHNode*& root, const AABB& newBounds, const Primitive& payload) {
+        const auto handle = static_cast<Handle>(locations.size());
+        BVHNode* leaf = allocateNode();
         leaf->bounds = newBounds;
 
         leaf->primitives.emplace_back(payload);
+        leaf->handles.emplace_back(handle);
+        locations.push_back(Location{leaf, 0});
+        updateStats(leaf);
+        leaf->builtCost = leaf->cost;
 
         if (!root) {
             root = leaf;
-            return;
+            return handle;
         }
 
         BVHNode* sibling = findBestSibling(newBounds, root);
-        BVHNode* newParent = &nodes.emplace_back(primitivesArena);
+        BVHNode* newParent = allocateNode();
         newParent->bounds = geom::merge(sibling->bounds, newBounds);
   
         newParent->left = sibling;
@@ -364,7 +733,10 @@ public:
         }
         sibling->parent = newParent;
         leaf->parent = newParent;
+        updateStats(newParent);
+        newParent->builtCost = newParent->cost;
         refitUpwards(newParent);
+        return handle;
     }
 
     void refitUpwards(BVHNode* node) {
@@ -372,16 +744,133 @@ public:
             if (!node->isLeaf()) {
                 node->bounds = geom::merge(node->left->bounds, node->right->bounds);
             }
+            updateStats(node);
             node = node->parent;
         }
     }
 
     void updateBounds(BVHNode* node) {
-        AABB newBounds{};
-        for (const auto& prim : node->primitives) {
-            newBounds = geom::merge(newBounds, prim);
+        refitNode(node);
+    }
+
+    /* queues a leaf whose primitives changed for the next refit */
+    void markDirty(BVHNode* leaf) {
+        if (leaf->dirty) return;
+
+        leaf->dirty = true;
+        dirtyLeaves.push_back(leaf);
+    }
+
+    /* queues the leaf holding handle for the next refit */
+    void markDirty(const Handle handle) {
+        markDirty(locations[handle].leaf);
+    }
+
+    /* overwrites the primitive behind handle and queues its leaf for the next refit */
+    void update(const Handle handle, const Primitive& primitive) {
+        const Location& location = locations[handle];
+        location.leaf->primitives[location.slot] = primitive;
+        markDirty(location.leaf);
+    }
+
+    const Primitive& get(const Handle handle) const {
+        const Location& location = locations[handle];
+        return location.leaf->primitives[location.slot];
+    }
+
+    struct RefitSettings {
+        /* subtrees whose SAH cost grew by this factor since they were built are rebuilt, 0 never rebuilds */
+        float rebuildRatio = 1.5f;
+        /* smaller subtrees are only refit, rebuilding them does not pay off */
+        size_t minRebuildPrimitives = 64;
+        bool parallel = true;
+    };
+
+    /**
+     * Refits every node above the leaves passed to markDirty, one tree level at a time from the deepest,
+     * the nodes of a level in parallel. Afterwards the topmost subtrees whose SAH cost degraded past
+     * settings.rebuildRatio are rebuilt in place. Once rebuilds left more dead primitives in the arena
+     * than live ones the whole hierarchy is rebuilt into one block, which moves every node.
+     * Returns how many subtrees were rebuilt
+     */
+    size_t refit(const RefitSettings& settings = {}) {
+        if (dirtyLeaves.empty() || !_root) {
+            dirtyLeaves.clear();
+            return 0;
+        }
+
+        for (BVHNode* leaf : dirtyLeaves) {
+            for (BVHNode* node = leaf->parent; node && !node->dirty; node = node->parent) {
+                node->dirty = true;
+            }
+        }
+        dirtyLeaves.clear();
+
+        // the dirty nodes form a tree under the root, split it into levels top down
+        size_t depth = 0;
+        if (refitLevels.empty()) refitLevels.emplace_back();
+        refitLevels[0].assign(1, _root);
+
+        while (!refitLevels[depth].empty()) {
+            if (refitLevels.size() <= depth + 1) refitLevels.emplace_back();
+            auto& next = refitLevels[depth + 1];
+            next.clear();
+
+            for (BVHNode* node : refitLevels[depth]) {
+                if (node->isLeaf()) continue;
+                if (node->left->dirty) next.push_back(node->left);
+                if (node->right->dirty) next.push_back(node->right);
+            }
+            ++depth;
+        }
+
+        for (size_t level = depth; level-- > 0;) {
+            auto& nodesOfLevel = refitLevels[level];
+
+            if (settings.parallel && nodesOfLevel.size() >= REFIT_GRAIN) {
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, nodesOfLevel.size(), REFIT_GRAIN / 4), [&](const tbb::blocked_range<size_t>& range) {
+                    for (size_t i = range.begin(); i < range.end(); ++i) {
+                        refitNode(nodesOfLevel[i]);
+                    }
+                });
+            } else {
+                for (BVHNode* node : nodesOfLevel) {
+                    refitNode(node);
+                }
+            }
+        }
+
+        if (settings.rebuildRatio <= 0.0f) {
+            return 0;
         }
-        node->bounds = newBounds;
+
+        // dirty now marks nodes inside a subtree already picked for a rebuild
+        std::vector<BVHNode*> degraded;
+        for (size_t level = 0; level < depth; ++level) {
+            for (BVHNode* node : refitLevels[level]) {
+                if (node->parent && node->parent->dirty) {
+                    node->dirty = true;
+                    continue;
+                }
+                if (!node->isLeaf() && node->count >= settings.minRebuildPrimitives && node->cost > node->builtCost * settings.rebuildRatio) {
+                    node->dirty = true;
+                    degraded.push_back(node);
+                }
+            }
+        }
+        for (size_t level = 0; level < depth; ++level) {
+            for (BVHNode* node : refitLevels[level]) {
+                node->dirty = false;
+            }
+        }
+
+        for (BVHNode* node : degraded) {
+            rebuildSubtree(node, settings.parallel);
+        }
+        if (deadPrimitives > primitiveCount) {
+            compact(settings.parallel);
+        }
+        return degraded.size();
     }
 
     struct FindResult {
@@ -396,6 +885,12 @@ public:
         }
     };
 
+    /* overwrites a primitive found with find and queues its leaf for the next refit, prefer the handle overload over a find */
+    void update(const FindResult& found, const Primitive& primitive) {
+        *found.primitive = primitive;
+        markDirty(found.node);
+    }
+
     template <typename T>
     FindResult find(const T& item) {
         for (auto& node : nodes) {
@@ -449,7 +944,7 @@ public:
     requires std::is_invocable_r_v<void, Callable, const BVHNode&>
     void forEachNode(Callable&& callable) const {
         for (const auto& node : nodes) {
-            callable(node);
+            if (!node.released) callable(node);
         }
     }
 
@@ -466,11 +961,11 @@ public:
     }
 
     size_t nodeCount() const {
-        return nodes.count();
+        return nodes.size() - freeNodes.size();
     }
 
     size_t size() const {
-        return primitivesArena.bytes_used() / sizeof(Primitive);
+        return primitiveCount;
     }
 
     bool empty() const {
@@ -479,6 +974,11 @@ public:
 
     void clear() {
         nodes.clear();
+        freeNodes.clear();
+        dirtyLeaves.clear();
+        locations.clear();
+        primitiveCount = 0;
+        deadPrimitives = 0;
         primitivesArena.reset_shrink();
         _root = nullptr;
     }
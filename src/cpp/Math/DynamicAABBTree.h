@@ -0,0 +1,479 @@
+#pragma once
+#include "Shapes/AABB.h"
+#include "Shapes/Ray.h"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <constexpr/assert.h>
+
+/**
+ * Incrementally built AABB tree for moving objects. Leaves store a fat box, the object's box grown by margin,
+ * and a move only reinserts the leaf once the object leaves it or shrinks well inside it.
+ * Inserts pick the sibling that grows surface area the least and AVL style rotations keep the tree balanced,
+ * so insert, remove and move are O(log n). Nodes live in a pool, a proxy id is its leaf's index and stays valid
+ * until the proxy is destroyed
+ */
+template <typename T>
+class DynamicAABBTree {
+public:
+    constexpr static int32_t NULL_NODE = -1;
+private:
+    constexpr static int STACK_SIZE = 256;
+
+    struct Node {
+        glm::vec3 min{};
+        glm::vec3 max{};
+        T data{};
+        /* next free node while the node is free */
+        int32_t parent = NULL_NODE;
+        int32_t left = NULL_NODE;
+        int32_t right = NULL_NODE;
+        /* 0 for leaves, -1 for free nodes */
+        int32_t height = -1;
+
+        bool isLeaf() const {
+            return left == NULL_NODE;
+        }
+    };
+
+    std::vector<Node> nodes{};
+    int32_t root = NULL_NODE;
+    int32_t freeList = NULL_NODE;
+    size_t proxyCount = 0;
+    float margin = 0.1f;
+
+    static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+        const glm::vec3 e = max - min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    static bool contains(const Node& outer, const glm::vec3& min, const glm::vec3& max) {
+        return glm::all(glm::lessThanEqual(outer.min, min)) && glm::all(glm::lessThanEqual(max, outer.max));
+    }
+
+    static bool overlaps(const Node& node, const glm::vec3& min, const glm::vec3& max) {
+        return glm::all(glm::lessThanEqual(node.min, max)) && glm::all(glm::lessThanEqual(min, node.max));
+    }
+
+    int32_t allocateNode() {
+        if (freeList == NULL_NODE) {
+            nodes.emplace_back();
+            return static_cast<int32_t>(nodes.size() - 1);
+        }
+
+        const int32_t index = freeList;
+        freeList = nodes[index].parent;
+        nodes[index] = Node();
+        return index;
+    }
+
+    void freeNode(const int32_t index) {
+        nodes[index] = Node();
+        nodes[index].parent = freeList;
+        freeList = index;
+    }
+
+    void refit(const int32_t index) {
+        Node& node = nodes[index];
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+
+        node.min = glm::min(left.min, right.min);
+        node.max = glm::max(left.max, right.max);
+        node.height = 1 + std::max(left.height, right.height);
+    }
+
+    /* rotates the taller grandchild up when a's children differ in height by more than one, returns the subtree root */
+    int32_t balance(const int32_t a) {
+        if (nodes[a].isLeaf() || nodes[a].height < 2) {
+            return a;
+        }
+
+        const int32_t b = nodes[a].left;
+        const int32_t c = nodes[a].right;
+        const int32_t difference = nodes[c].height - nodes[b].height;
+
+        if (difference > 1) {
+            return rotateUp(a, c, b, false);
+        }
+        if (difference < -1) {
+            return rotateUp(a, b, c, true);
+        }
+        return a;
+    }
+
+    /* child of a takes a's place, a keeps other and the shorter grandchild, child keeps the taller one */
+    int32_t rotateUp(const int32_t a, const int32_t child, const int32_t other, const bool childIsLeft) {
+        const int32_t f = nodes[child].left;
+        const int32_t g = nodes[child].right;
+
+        nodes[child].left = a;
+        nodes[child].parent = nodes[a].parent;
+        nodes[a].parent = child;
+
+        if (const int32_t parent = nodes[child].parent; parent != NULL_NODE) {
+            if (nodes[parent].left == a) nodes[parent].left = child;
+            else nodes[parent].right = child;
+        } else {
+            root = child;
+        }
+
+        const bool fTaller = nodes[f].height > nodes[g].height;
+        const int32_t taller = fTaller ? f : g;
+        const int32_t shorter = fTaller ? g : f;
+
+        nodes[child].right = taller;
+        if (childIsLeft) {
+            nodes[a].left = shorter;
+            nodes[a].right = other;
+        } else {
+            nodes[a].left = other;
+            nodes[a].right = shorter;
+        }
+        nodes[shorter].parent = a;
+
+        refit(a);
+        refit(child);
+        return child;
+    }
+
+    void insertLeaf(const int32_t leaf) {
+        if (root == NULL_NODE) {
+            root = leaf;
+            nodes[leaf].parent = NULL_NODE;
+            return;
+        }
+
+        const glm::vec3 leafMin = nodes[leaf].min;
+        const glm::vec3 leafMax = nodes[leaf].max;
+
+        // descends while making leaf a child here costs more than pushing it further down
+        int32_t index = root;
+        while (!nodes[index].isLeaf()) {
+            const Node& node = nodes[index];
+
+            const float area = surfaceArea(node.min, node.max);
+            const float combinedArea = surfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+            const float cost = 2.0f * combinedArea;
+            const float inheritance = 2.0f * (combinedArea - area);
+
+            const auto descendCost = [&](const Node& child) {
+                const float grown = surfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+                return child.isLeaf() ? grown + inheritance : grown - surfaceArea(child.min, child.max) + inheritance;
+            };
+            const float leftCost = descendCost(nodes[node.left]);
+            const float rightCost = descendCost(nodes[node.right]);
+
+            if (cost < leftCost && cost < rightCost) {
+                break;
+            }
+            index = leftCost < rightCost ? node.left : node.right;
+        }
+
+        const int32_t sibling = index;
+        const int32_t oldParent = nodes[sibling].parent;
+        const int32_t newParent = allocateNode();
+
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].left = sibling;
+        nodes[newParent].right = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        refit(newParent);
+
+        if (oldParent != NULL_NODE) {
+            if (nodes[oldParent].left == sibling) nodes[oldParent].left = newParent;
+            else nodes[oldParent].right = newParent;
+        } else {
+            root = newParent;
+        }
+
+        fixUpwards(oldParent);
+    }
+
+    void removeLeaf(const int32_t leaf) {
+        if (leaf == root) {
+            root = NULL_NODE;
+            return;
+        }
+
+        const int32_t parent = nodes[leaf].parent;
+        const int32_t grandParent = nodes[parent].parent;
+        const int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        if (grandParent != NULL_NODE) {
+            if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+            else nodes[grandParent].right = sibling;
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            fixUpwards(grandParent);
+        } else {
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+            freeNode(parent);
+        }
+    }
+
+    /* refits and rebalances from index up to the root */
+    void fixUpwards(int32_t index) {
+        while (index != NULL_NODE) {
+            index = balance(index);
+            refit(index);
+            index = nodes[index].parent;
+        }
+    }
+
+    void setFatBounds(const int32_t leaf, const AABB& aabb) {
+        nodes[leaf].min = aabb.min() - margin;
+        nodes[leaf].max = aabb.max() + margin;
+    }
+
+    template <typename Fn, typename... Args>
+    static bool invoke(Fn& fn, Args&&... args) {
+        if constexpr (std::is_invocable_r_v<bool, Fn, Args...>) {
+            return fn(std::forward<Args>(args)...);
+        } else {
+            fn(std::forward<Args>(args)...);
+            return false;
+        }
+    }
+public:
+    DynamicAABBTree() = default;
+
+    explicit DynamicAABBTree(const float margin) : margin(margin) {}
+
+    int32_t createProxy(const AABB& aabb, const T& data) {
+        const int32_t proxy = allocateNode();
+        setFatBounds(proxy, aabb);
+        nodes[proxy].data = data;
+        nodes[proxy].height = 0;
+
+        insertLeaf(proxy);
+        ++proxyCount;
+        return proxy;
+    }
+
+    void destroyProxy(const int32_t proxy) {
+        cexpr::require(isProxy(proxy));
+
+        removeLeaf(proxy);
+        freeNode(proxy);
+        --proxyCount;
+    }
+
+    /**
+     * Stores the new box of proxy, reinserts it only when aabb left the fat box or the fat box became
+     * loose enough to hold aabb grown by four margins. Returns whether the tree changed
+     */
+    bool moveProxy(const int32_t proxy, const AABB& aabb) {
+        cexpr::require(isProxy(proxy));
+        const glm::vec3 min = aabb.min();
+        const glm::vec3 max = aabb.max();
+
+        if (contains(nodes[proxy], min, max)) {
+            const Node huge{min - 4.0f * margin, max + 4.0f * margin};
+
+            if (contains(huge, nodes[proxy].min, nodes[proxy].max)) {
+                return false;
+            }
+        }
+
+        removeLeaf(proxy);
+        setFatBounds(proxy, aabb);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    bool isProxy(const int32_t proxy) const {
+        return proxy >= 0 && static_cast<size_t>(proxy) < nodes.size() && nodes[proxy].height == 0;
+    }
+
+    T& getData(const int32_t proxy) {
+        return nodes[proxy].data;
+    }
+
+    const T& getData(const int32_t proxy) const {
+        return nodes[proxy].data;
+    }
+
+    AABB getFatBounds(const int32_t node) const {
+        return AABB::fromTo(nodes[node].min, nodes[node].max);
+    }
+
+    /* fn(int32_t proxy), or bool(int32_t proxy) returning true to stop, for every fat box overlapping aabb */
+    template <typename Fn>
+    void query(const AABB& aabb, Fn&& fn) const {
+        if (root == NULL_NODE) {
+            return;
+        }
+        const glm::vec3 min = aabb.min();
+        const glm::vec3 max = aabb.max();
+
+        int32_t stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = root;
+
+        while (top) {
+            const Node& node = nodes[stack[--top]];
+
+            if (!overlaps(node, min, max)) {
+                continue;
+            }
+            if (node.isLeaf()) {
+                if (invoke(fn, static_cast<int32_t>(&node - nodes.data()))) return;
+                continue;
+            }
+            cexpr::require(top + 2 <= STACK_SIZE);
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+
+    /**
+     * fn(int32_t proxy, const Ray& clipped) -> float for every fat box the ray hits, nearest subtree first.
+     * fn returns the length the ray keeps going for, 0 stops
+     */
+    template <typename Fn>
+    void raycast(const Ray& ray, Fn&& fn) const {
+        if (root == NULL_NODE) {
+            return;
+        }
+        Ray clipped = ray;
+
+        struct Entry {
+            int32_t node;
+            float distance;
+        };
+        Entry stack[STACK_SIZE];
+        int top = 0;
+
+        if (const RayResult hit = clipped.intersects(getFatBounds(root)); hit.hasHit()) {
+            stack[top++] = {root, hit.distance};
+        }
+
+        while (top) {
+            const Entry entry = stack[--top];
+            if (entry.distance > clipped.length) {
+                continue;
+            }
+            const Node& node = nodes[entry.node];
+
+            if (node.isLeaf()) {
+                const float length = fn(entry.node, static_cast<const Ray&>(clipped));
+                if (length <= 0.0f) return;
+                clipped.length = std::min(clipped.length, length);
+                continue;
+            }
+
+            const RayResult left = clipped.intersects(getFatBounds(node.left));
+            const RayResult right = clipped.intersects(getFatBounds(node.right));
+
+            // the nearer child goes on top
+            cexpr::require(top + 2 <= STACK_SIZE);
+            const bool leftFirst = !right.hasHit() || (left.hasHit() && left.distance <= right.distance);
+            const auto push = [&](const int32_t child, const RayResult& hit) {
+                if (hit.hasHit()) stack[top++] = {child, hit.distance};
+            };
+            if (leftFirst) {
+                push(node.right, right);
+                push(node.left, left);
+            } else {
+                push(node.left, left);
+                push(node.right, right);
+            }
+        }
+    }
+
+    /**
+     * Depth first walk carrying per path state, visit(int32_t node, const AABB& fatBounds, bool leaf, State& state)
+     * returns whether to descend into the node's children, which start from the state visit left behind
+     */
+    template <typename State, typename Visit>
+    void walk(const State& initial, Visit&& visit) const {
+        if (root == NULL_NODE) {
+            return;
+        }
+
+        struct Entry {
+            int32_t node;
+            State state;
+        };
+        Entry stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = {root, initial};
+
+        while (top) {
+            Entry entry = stack[--top];
+            const Node& node = nodes[entry.node];
+
+            if (!visit(entry.node, getFatBounds(entry.node), node.isLeaf(), entry.state) || node.isLeaf()) {
+                continue;
+            }
+            cexpr::require(top + 2 <= STACK_SIZE);
+            stack[top++] = {node.right, entry.state};
+            stack[top++] = {node.left, entry.state};
+        }
+    }
+
+    /* fn(int32_t proxy) for every leaf below node */
+    template <typename Fn>
+    void forEachLeaf(const int32_t node, Fn&& fn) const {
+        int32_t stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = node;
+
+        while (top) {
+            const int32_t index = stack[--top];
+
+            if (nodes[index].isLeaf()) {
+                fn(index);
+                continue;
+            }
+            cexpr::require(top + 2 <= STACK_SIZE);
+            stack[top++] = nodes[index].right;
+            stack[top++] = nodes[index].left;
+        }
+    }
+
+    int32_t getRoot() const {
+        return root;
+    }
+
+    int32_t getHeight() const {
+        return root == NULL_NODE ? 0 : nodes[root].height;
+    }
+
+    /* combined surface area of the inner nodes over the root's, lower is tighter */
+    float getAreaRatio() const {
+        if (root == NULL_NODE) {
+            return 0.0f;
+        }
+
+        float total = 0.0f;
+        for (const Node& node : nodes) {
+            if (node.height > 0) total += surfaceArea(node.min, node.max);
+        }
+        return total / std::max(surfaceArea(nodes[root].min, nodes[root].max), 1e-12f);
+    }
+
+    float getMargin() const {
+        return margin;
+    }
+
+    size_t size() const {
+        return proxyCount;
+    }
+
+    bool empty() const {
+        return !proxyCount;
+    }
+
+    void clear() {
+        nodes.clear();
+        root = NULL_NODE;
+        freeList = NULL_NODE;
+        proxyCount = 0;
+    }
+};
@@ -0,0 +1,570 @@
+#pragma once
+#include "BoundingVolumeHierarchy.h"
+#include "Shapes/RayPacket.h"
+#include <bit>
+#include <span>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 32 byte node of a LinearBoundingVolumeHierarchy, two fit in a cache line.
+ * Interior nodes keep their left child right after themselves, offset is the right child.
+ * Leaves have the leaf bit set and offset is their first primitive, count may be 0
+ */
+struct alignas(32) LinearBVHNode {
+    glm::vec3 min{};
+    uint32_t offset = 0;
+    glm::vec3 max{};
+    uint32_t count : 24 = 0;
+    uint32_t axis : 7 = 0;
+    uint32_t leaf : 1 = 0;
+
+    bool isLeaf() const {
+        return leaf;
+    }
+
+    AABB bounds() const {
+        return AABB::fromTo(min, max);
+    }
+};
+static_assert(sizeof(LinearBVHNode) == 32);
+
+/**
+ * Read mostly BVH stored as one node array in depth first order, primitives are reordered so
+ * every leaf owns a contiguous run. Traversal walks the array with a small fixed stack and visits
+ * the nearer child first along the split axis.
+ * Built with the bucketed SAH (same splits as BoundingVolumeHierarchy), with a Morton code LBVH
+ * when build speed matters more than tree quality, or flattened from an existing BoundingVolumeHierarchy
+ */
+template <typename Primitive> requires (!std::is_same_v<primitive_type_t<Primitive>, void>)
+class LinearBoundingVolumeHierarchy {
+public:
+    using Node = LinearBVHNode;
+    using Source = BoundingVolumeHierarchy<Primitive>;
+
+    constexpr static int MAX_DEPTH = 128;
+private:
+    mem::vector<Node> nodes;
+    mem::vector<Primitive> primitives;
+
+    static void setBounds(Node& node, const AABB& bounds) {
+        node.min = bounds.min();
+        node.max = bounds.max();
+    }
+
+    static void merge(Node& node, const Node& other) {
+        node.min = glm::min(node.min, other.min);
+        node.max = glm::max(node.max, other.max);
+    }
+
+    uint32_t makeLeaf(const uint32_t index, const size_t start, const size_t end) {
+        cexpr::require(end - start < (1u << 24));
+
+        Node& node = nodes[index];
+        node.offset = static_cast<uint32_t>(start);
+        node.count = static_cast<uint32_t>(end - start);
+        node.leaf = 1;
+        return index;
+    }
+
+    uint32_t emit(const typename Source::BuildNode* split) {
+        const auto index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        setBounds(nodes[index], split->bounds);
+
+        if (split->isLeaf()) {
+            return makeLeaf(index, split->start, split->end);
+        }
+
+        emit(split->left);
+        const uint32_t right = emit(split->right);
+
+        nodes[index].offset = right;
+        nodes[index].axis = static_cast<uint32_t>(split->axis);
+        return index;
+    }
+
+    /* 10 bits per axis interleaved as ..zyxzyx, x takes the highest bit of every triple */
+    static uint32_t expandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    static uint32_t mortonCode(const glm::vec3 normalized) {
+        const glm::vec3 cell = glm::clamp(normalized * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+        return (expandBits(static_cast<uint32_t>(cell.x)) << 2)
+            | (expandBits(static_cast<uint32_t>(cell.y)) << 1)
+            | expandBits(static_cast<uint32_t>(cell.z));
+    }
+
+    /* codes are sorted, a range sharing its top bits splits where its highest differing bit flips */
+    uint32_t buildMorton(const uint32_t* codes, const size_t start, const size_t end, const size_t maxLeafSize) {
+        const auto index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        if (end - start <= maxLeafSize) {
+            setBounds(nodes[index], Source::computeBounds(primitives.data(), start, end));
+            return makeLeaf(index, start, end);
+        }
+
+        const uint32_t first = codes[start];
+        const uint32_t last = codes[end - 1];
+
+        size_t mid = start + (end - start) / 2;
+        int axis = 0;
+
+        if (first != last) {
+            const int bit = 31 - std::countl_zero(first ^ last);
+            const uint32_t mask = 1u << bit;
+
+            mid = std::partition_point(codes + start, codes + end, [&](const uint32_t code) {
+                return !(code & mask);
+            }) - codes;
+            axis = 2 - bit % 3;
+        }
+
+        buildMorton(codes, start, mid, maxLeafSize);
+        const uint32_t right = buildMorton(codes, mid, end, maxLeafSize);
+
+        Node& node = nodes[index];
+        node.min = nodes[index + 1].min;
+        node.max = nodes[index + 1].max;
+        merge(node, nodes[right]);
+        node.offset = right;
+        node.axis = static_cast<uint32_t>(axis);
+        return index;
+    }
+
+    uint32_t flatten(const typename Source::BVHNode* source) {
+        const auto index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        setBounds(nodes[index], source->bounds);
+
+        if (source->isLeaf()) {
+            const size_t start = primitives.size();
+            for (const auto& primitive : source->primitives) {
+                primitives.emplace_back(primitive);
+            }
+            return makeLeaf(index, start, primitives.size());
+        }
+
+        flatten(source->left);
+        const uint32_t right = flatten(source->right);
+
+        const glm::vec3 extent = nodes[index].max - nodes[index].min;
+        int axis = 0;
+        if (extent.y > extent.x) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+
+        nodes[index].offset = right;
+        nodes[index].axis = static_cast<uint32_t>(axis);
+        return index;
+    }
+
+    template <typename Range>
+    void copyPrimitives(Range&& range) {
+        clear();
+        primitives.reserve(range.size());
+        for (const auto& primitive : range) {
+            primitives.emplace_back(primitive);
+        }
+        nodes.reserve(2 * range.size() + 1);
+    }
+
+    static bool overlaps(const Node& node, const glm::vec3& min, const glm::vec3& max) {
+        return node.min.x <= max.x && node.max.x >= min.x
+            && node.min.y <= max.y && node.max.y >= min.y
+            && node.min.z <= max.z && node.max.z >= min.z;
+    }
+
+    static bool slab(const Node& node, const glm::vec3& origin, const glm::vec3& invDir, const float length) {
+        const glm::vec3 t0 = (node.min - origin) * invDir;
+        const glm::vec3 t1 = (node.max - origin) * invDir;
+        const glm::vec3 tmin = glm::min(t0, t1);
+        const glm::vec3 tmax = glm::max(t0, t1);
+
+        const float tEnter = glm::max(glm::max(tmin.x, tmin.y), glm::max(tmin.z, 0.0f));
+        const float tExit = glm::min(glm::min(tmax.x, tmax.y), glm::min(tmax.z, length));
+        return tEnter <= tExit;
+    }
+
+    template <bool Transform, typename Callable>
+    bool forEachRayIntersects(const Ray& ray, const glm::mat4& bvhWorldTransform, const glm::mat3& normalMatrix, Callable&& callable) const {
+        if (nodes.empty()) return false;
+
+        const glm::vec3 invDir(RayPacket::reciprocal(ray.direction.x), RayPacket::reciprocal(ray.direction.y), RayPacket::reciprocal(ray.direction.z));
+        const bool negative[3] = { ray.direction.x < 0.0f, ray.direction.y < 0.0f, ray.direction.z < 0.0f };
+
+        uint32_t stack[MAX_DEPTH];
+        int top = 0;
+        uint32_t at = 0;
+
+        while (true) {
+            const Node& node = nodes[at];
+
+            if (slab(node, ray.origin, invDir, ray.length)) {
+                if (node.isLeaf()) {
+                    for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                        const Primitive& primitive = primitives[i];
+
+                        if (RayResult result = ray.intersects(Source::primitive_cast(primitive)); result.hasHit()) {
+                            BVHRayResult<Primitive> bvhResult;
+                            bvhResult.distance = result.distance;
+                            if constexpr (Transform) {
+                                bvhResult.hitPos = glm::vec3(bvhWorldTransform * glm::vec4(result.hitPos, 1.0f));
+                                bvhResult.normal = glm::normalize(normalMatrix * result.normal);
+                            } else {
+                                bvhResult.hitPos = result.hitPos;
+                                bvhResult.normal = result.normal;
+                            }
+                            bvhResult.primitive = &primitive;
+
+                            if (callable(bvhResult)) return true;
+                        }
+                    }
+                } else {
+                    cexpr::require(top < MAX_DEPTH);
+
+                    // the child on the ray's side of the split goes first
+                    if (negative[node.axis]) {
+                        stack[top++] = at + 1;
+                        at = node.offset;
+                    } else {
+                        stack[top++] = node.offset;
+                        at = at + 1;
+                    }
+                    continue;
+                }
+            }
+            if (!top) return false;
+            at = stack[--top];
+        }
+    }
+
+    /**
+     * Walks the tree once for the whole packet, a subtree is entered with the rays that hit its bounds.
+     * callable(lane, result) returns true to retire the ray, it may shorten tFar[lane] to cull farther boxes
+     */
+    template <typename Callable>
+    void tracePacket(const RayPacket& packet, float* tFar, Callable&& callable) const {
+        if (nodes.empty()) return;
+
+        struct Entry {
+            uint32_t node;
+            uint32_t rays;
+        };
+        Entry stack[MAX_DEPTH];
+        int top = 0;
+
+        uint32_t active = packet.mask();
+        Entry at = { 0, active };
+
+        while (true) {
+            const Node& node = nodes[at.node];
+            const uint32_t rays = at.rays & active;
+            const uint32_t hits = rays ? packet.intersectsSlab(node.min, node.max, tFar) & rays : 0;
+
+            if (hits) {
+                if (node.isLeaf()) {
+                    for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                        const Primitive& primitive = primitives[i];
+
+                        for (uint32_t lanes = hits & active; lanes; lanes &= lanes - 1) {
+                            const int lane = std::countr_zero(lanes);
+                            const RayResult result = packet.rays[lane].intersects(Source::primitive_cast(primitive));
+                            if (!result.hasHit() || result.distance > tFar[lane]) continue;
+
+                            BVHRayResult<Primitive> bvhResult;
+                            bvhResult.distance = result.distance;
+                            bvhResult.hitPos = result.hitPos;
+                            bvhResult.normal = result.normal;
+                            bvhResult.primitive = &primitive;
+
+                            if (callable(lane, bvhResult)) {
+                                active &= ~(1u << lane);
+                            }
+                        }
+                    }
+                } else {
+                    cexpr::require(top < MAX_DEPTH);
+
+                    // order by the first ray that hit, coherent packets agree on it
+                    const int lead = std::countr_zero(hits);
+                    const float direction = packet.rays[lead].direction[static_cast<int>(node.axis)];
+
+                    if (direction < 0.0f) {
+                        stack[top++] = { at.node + 1, hits };
+                        at = { node.offset, hits };
+                    } else {
+                        stack[top++] = { node.offset, hits };
+                        at = { at.node + 1, hits };
+                    }
+                    continue;
+                }
+            }
+            if (!top || !active) return;
+            at = stack[--top];
+        }
+    }
+public:
+    LinearBoundingVolumeHierarchy() = default;
+
+    explicit LinearBoundingVolumeHierarchy(const Source& bvh) {
+        flatten(bvh);
+    }
+
+    /* bucketed SAH build, same splits as BoundingVolumeHierarchy::build and just as deterministic when parallel */
+    template <typename Range>
+    void build(Range&& range, const size_t maxLeafSize, const bool parallel = true) {
+        copyPrimitives(range);
+        if (primitives.empty()) return;
+
+        typename Source::BuildArena arena;
+        emit(Source::buildSplits(arena, primitives.data(), 0, primitives.size(), maxLeafSize, parallel));
+    }
+
+    /**
+     * LBVH build: primitives are sorted by the Morton code of their centroid and split at the highest
+     * differing bit. Linear in the primitive count after the sort, trees are looser than SAH ones
+     */
+    template <typename Range>
+    void buildMorton(Range&& range, const size_t maxLeafSize) {
+        copyPrimitives(range);
+        if (primitives.empty()) return;
+
+        const size_t count = primitives.size();
+        const AABB centroidBounds = Source::computeCentroidBounds(primitives.data(), 0, count);
+        const glm::vec3 origin = centroidBounds.min();
+        const glm::vec3 scale = 1.0f / glm::max(centroidBounds.max() - origin, glm::vec3(1e-6f));
+
+        // code in the high half, index in the low one, a plain sort is deterministic
+        std::vector<uint64_t> keys(count);
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t code = mortonCode((geom::centroid(Source::primitive_cast(primitives[i])) - origin) * scale);
+            keys[i] = static_cast<uint64_t>(code) << 32 | i;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        mem::vector<Primitive> sorted;
+        sorted.reserve(count);
+        std::vector<uint32_t> codes(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            sorted.emplace_back(primitives[keys[i] & 0xFFFFFFFFu]);
+            codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+        }
+        primitives = std::move(sorted);
+
+        buildMorton(codes.data(), 0, count, maxLeafSize);
+    }
+
+    /* copies an existing hierarchy into depth first order, keeps its leaves as they are */
+    void flatten(const Source& bvh) {
+        clear();
+        if (!bvh.root() || (bvh.root()->isLeaf() && bvh.root()->primitives.empty())) return;
+
+        nodes.reserve(bvh.nodeCount());
+        flatten(bvh.root());
+    }
+
+    template <typename Callable>
+    /* bool(const Primitive&) -> return true to early exit */
+    requires std::is_invocable_r_v<bool, Callable, const Primitive&>
+    void forEachIntersects(const AABB& aabb, Callable&& callable) const {
+        if (nodes.empty()) return;
+
+        const glm::vec3 min = aabb.min();
+        const glm::vec3 max = aabb.max();
+
+        uint32_t stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top) {
+            const uint32_t at = stack[--top];
+            const Node& node = nodes[at];
+
+            if (!overlaps(node, min, max)) continue;
+
+            if (node.isLeaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                    if (geom::intersects(aabb, primitives[i])) {
+                        if (callable(primitives[i])) return;
+                    }
+                }
+            } else {
+                cexpr::require(top + 2 <= MAX_DEPTH);
+                stack[top++] = node.offset;
+                stack[top++] = at + 1;
+            }
+        }
+    }
+
+    template <typename Callable>
+    /* bool(const BVHRayResult<Primitive>&) -> return true to early exit */
+    void forEachRayIntersects(const Ray& ray, const glm::mat4& bvhWorldTransform, Callable&& callable) const {
+        const glm::mat4 bvhLocalTransform = glm::inverse(bvhWorldTransform);
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(bvhWorldTransform)));
+        const Ray localRay = geom::transform(ray, bvhLocalTransform);
+
+        forEachRayIntersects<true>(localRay, bvhWorldTransform, normalMatrix, std::forward<Callable>(callable));
+    }
+
+    template <typename Callable>
+    void forEachRayIntersects(const Ray& ray, Callable&& callable) const {
+        static glm::mat4 identity{};
+        forEachRayIntersects<false>(ray, identity, identity, std::forward<Callable>(callable));
+    }
+
+    template <typename Callable>
+    /**
+     * @param localRay should be in BVH-Local space
+     * @param callable bool(const BVHRayResult<Primitive>&) -> return true to early exit
+     */
+    void forEachRayIntersects(const Ray& localRay, const glm::mat4& bvhWorldTransform, const glm::mat3& normalMatrix, Callable&& callable) const {
+        forEachRayIntersects<true>(localRay, bvhWorldTransform, normalMatrix, std::forward<Callable>(callable));
+    }
+
+    template <typename Callable>
+    /**
+     * Packet traversal for up to RayPacket::SIZE rays in BVH-Local space.
+     * @param callable bool(unsigned lane, const BVHRayResult<Primitive>&) -> return true to stop tracing that ray
+     */
+    void forEachPacketIntersects(const RayPacket& packet, Callable&& callable) const {
+        float tFar[RayPacket::SIZE];
+        for (int i = 0; i < RayPacket::SIZE; ++i) {
+            tFar[i] = packet.rays[i].length;
+        }
+        tracePacket(packet, tFar, [&](const unsigned lane, const BVHRayResult<Primitive>& result) {
+            return callable(lane, result);
+        });
+    }
+
+    /* nearest hit of every ray of the packet, rays that hit nothing get a distance of -1 */
+    void intersectClosest(const RayPacket& packet, BVHRayResult<Primitive>* hits) const {
+        float tFar[RayPacket::SIZE];
+        for (int i = 0; i < RayPacket::SIZE; ++i) {
+            tFar[i] = packet.rays[i].length;
+        }
+        for (uint32_t i = 0; i < packet.count; ++i) {
+            hits[i] = {};
+        }
+
+        tracePacket(packet, tFar, [&](const unsigned lane, const BVHRayResult<Primitive>& result) {
+            hits[lane] = result;
+            tFar[lane] = result.distance;
+            return false;
+        });
+    }
+
+    /**
+     * Nearest hit of every ray in BVH-Local space, for picking, visibility probes and baking.
+     * Rays are grouped by direction octant and traced RayPacket::SIZE at a time, in input order within
+     * an octant, so callers get the most out of packets by passing spatially coherent rays next to each other.
+     * Packets are spread over the tbb pool when parallel, hits holds one result per ray
+     */
+    void intersectClosest(const std::span<const Ray> rays, const std::span<BVHRayResult<Primitive>> hits, const bool parallel = true) const {
+        cexpr::require(hits.size() >= rays.size());
+
+        const auto octant = [](const Ray& ray) {
+            return (ray.direction.x < 0.0f ? 1 : 0) | (ray.direction.y < 0.0f ? 2 : 0) | (ray.direction.z < 0.0f ? 4 : 0);
+        };
+
+        // counting sort by octant, stable so the caller's ordering survives inside every octant
+        size_t first[9] = {};
+        for (const Ray& ray : rays) {
+            ++first[octant(ray) + 1];
+        }
+        for (int o = 0; o < 8; ++o) {
+            first[o + 1] += first[o];
+        }
+
+        std::vector<uint32_t> order(rays.size());
+        size_t cursor[8];
+        std::copy_n(first, 8, cursor);
+        for (size_t i = 0; i < rays.size(); ++i) {
+            order[cursor[octant(rays[i])]++] = static_cast<uint32_t>(i);
+        }
+
+        // packets never straddle two octants
+        std::vector<std::pair<uint32_t, uint32_t>> packets;
+        packets.reserve(rays.size() / RayPacket::SIZE + 8);
+        for (int o = 0; o < 8; ++o) {
+            for (size_t at = first[o]; at < first[o + 1]; at += RayPacket::SIZE) {
+                packets.emplace_back(static_cast<uint32_t>(at), static_cast<uint32_t>(std::min<size_t>(first[o + 1] - at, RayPacket::SIZE)));
+            }
+        }
+
+        const auto trace = [&](const size_t p) {
+            const auto [start, count] = packets[p];
+
+            Ray packed[RayPacket::SIZE];
+            for (uint32_t i = 0; i < count; ++i) {
+                packed[i] = rays[order[start + i]];
+            }
+
+            BVHRayResult<Primitive> results[RayPacket::SIZE];
+            intersectClosest(RayPacket(std::span<const Ray>(packed, count)), results);
+
+            for (uint32_t i = 0; i < count; ++i) {
+                hits[order[start + i]] = results[i];
+            }
+        };
+
+        if (parallel) {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, packets.size(), 16), [&](const tbb::blocked_range<size_t>& range) {
+                for (size_t p = range.begin(); p < range.end(); ++p) {
+                    trace(p);
+                }
+            });
+        } else {
+            for (size_t p = 0; p < packets.size(); ++p) {
+                trace(p);
+            }
+        }
+    }
+
+    template <typename Callable>
+    /* void(const LinearBVHNode& node), depth first order */
+    requires std::is_invocable_r_v<void, Callable, const Node&>
+    void forEachNode(Callable&& callable) const {
+        for (const auto& node : nodes) {
+            callable(node);
+        }
+    }
+
+    mem::range<const Node> getNodes() const {
+        return nodes;
+    }
+
+    mem::range<const Primitive> getPrimitives() const {
+        return primitives;
+    }
+
+    AABB bounds() const {
+        return nodes[0].bounds();
+    }
+
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    size_t size() const {
+        return primitives.size();
+    }
+
+    bool empty() const {
+        return primitives.empty();
+    }
+
+    void clear() {
+        nodes.clear();
+        primitives.clear();
+    }
+};
+
+template <typename P>
+using LinearBVH = LinearBoundingVolumeHierarchy<P>;
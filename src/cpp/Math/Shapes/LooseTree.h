@@ -0,0 +1,499 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+#include <constexpr/assert.h>
+#include "AABB.h"
+#include "Ray.h"
+
+/**
+ * Loose 2^Dimensions-ary tree (quadtree on x/y, octree on x/y/z) over items with a public `AABB aabb`.
+ * Every node's loose bounds are twice its cell, so an item sits in the node whose cell holds its center
+ * at the deepest level its size allows, and never straddles. Nodes live in a pool and are created on
+ * demand: a node splits once it holds more than nodeCapacity items, and is released as soon as it is empty
+ * and childless. Items live in a pooled slot array, a Handle reaches them in O(1) for get, remove and
+ * relocate. Queries never allocate, they call back or append to a caller provided buffer
+ */
+template <typename T, int Dimensions>
+class LooseTree {
+    static_assert(Dimensions == 2 || Dimensions == 3);
+public:
+    constexpr static int CHILDREN = 1 << Dimensions;
+    constexpr static int MAX_DEPTH = 16;
+
+    struct Handle {
+        uint32_t index = ~0u;
+        uint32_t generation = 0;
+
+        bool valid() const { return index != ~0u; }
+        bool operator==(const Handle&) const = default;
+    };
+private:
+    constexpr static uint32_t INVALID = ~0u;
+
+    struct Node {
+        glm::vec3 center{};
+        uint32_t parent = INVALID;
+        uint32_t children[CHILDREN];
+        uint32_t firstItem = INVALID;
+        uint32_t itemCount = 0;
+        uint8_t depth = 0;
+        uint8_t childCount = 0;
+        bool split = false;
+
+        Node() {
+            std::fill(std::begin(children), std::end(children), INVALID);
+        }
+    };
+
+    struct Slot {
+        std::optional<T> value{};
+        uint32_t node = INVALID;
+        uint32_t prev = INVALID;
+        uint32_t next = INVALID;
+        uint32_t generation = 0;
+    };
+
+    AABB bounds;
+    int nodeCapacity = 8;
+    int maxDepth = 8;
+    glm::vec3 levelHalfSize[MAX_DEPTH + 1]{};
+
+    std::vector<Node> nodes{};
+    std::vector<uint32_t> freeNodes{};
+    std::vector<Slot> slots{};
+    std::vector<uint32_t> freeSlots{};
+    size_t count = 0;
+
+    /* first Dimensions components of a <= b */
+    static bool allLessEqual(const glm::vec3& a, const glm::vec3& b) {
+        for (int i = 0; i < Dimensions; ++i) {
+            if (a[i] > b[i]) return false;
+        }
+        return true;
+    }
+
+    static bool overlaps(const glm::vec3& centerA, const glm::vec3& halfA, const glm::vec3& centerB, const glm::vec3& halfB) {
+        return allLessEqual(glm::abs(centerA - centerB), halfA + halfB);
+    }
+
+    bool insideRoot(const glm::vec3& point) const {
+        return allLessEqual(glm::abs(point - bounds.center), bounds.halfSize);
+    }
+
+    /* deepest level whose cells are at least as large as the item, loose bounds then always hold it */
+    int fitDepth(const AABB& aabb) const {
+        int depth = 0;
+        while (depth < maxDepth && allLessEqual(aabb.halfSize, levelHalfSize[depth + 1])) {
+            ++depth;
+        }
+        return depth;
+    }
+
+    static int childIndex(const Node& node, const glm::vec3& point) {
+        int index = 0;
+        for (int i = 0; i < Dimensions; ++i) {
+            index |= (point[i] >= node.center[i]) << i;
+        }
+        return index;
+    }
+
+    glm::vec3 looseHalfSize(const Node& node) const {
+        return levelHalfSize[node.depth] * 2.0f;
+    }
+
+    /* loose bounds for ray tests, a quadtree does not partition z so its nodes span every z */
+    AABB looseRayBounds(const Node& node) const {
+        glm::vec3 half = looseHalfSize(node);
+        if constexpr (Dimensions == 2) {
+            half.z = std::numeric_limits<float>::max();
+        }
+        return AABB(node.center, half);
+    }
+
+    uint32_t allocateNode() {
+        if (!freeNodes.empty()) {
+            const uint32_t index = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[index] = Node();
+            return index;
+        }
+        nodes.emplace_back();
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    uint32_t getOrCreateChild(const uint32_t parent, const int child) {
+        if (nodes[parent].children[child] != INVALID) {
+            return nodes[parent].children[child];
+        }
+
+        const uint32_t index = allocateNode();
+        Node& node = nodes[index];
+        Node& owner = nodes[parent];
+
+        const glm::vec3 quarter = levelHalfSize[owner.depth + 1];
+        node.center = owner.center;
+        for (int i = 0; i < Dimensions; ++i) {
+            node.center[i] += (child & (1 << i)) ? quarter[i] : -quarter[i];
+        }
+        node.parent = parent;
+        node.depth = owner.depth + 1;
+
+        owner.children[child] = index;
+        ++owner.childCount;
+        return index;
+    }
+
+    void link(const uint32_t item, const uint32_t node) {
+        Slot& slot = slots[item];
+        Node& owner = nodes[node];
+
+        slot.node = node;
+        slot.prev = INVALID;
+        slot.next = owner.firstItem;
+        if (owner.firstItem != INVALID) {
+            slots[owner.firstItem].prev = item;
+        }
+        owner.firstItem = item;
+        ++owner.itemCount;
+    }
+
+    void unlink(const uint32_t item) {
+        Slot& slot = slots[item];
+        Node& owner = nodes[slot.node];
+
+        if (slot.prev != INVALID) slots[slot.prev].next = slot.next;
+        else owner.firstItem = slot.next;
+        if (slot.next != INVALID) slots[slot.next].prev = slot.prev;
+
+        --owner.itemCount;
+        slot.node = slot.prev = slot.next = INVALID;
+    }
+
+    /* releases empty childless nodes from node upwards, the root stays */
+    void prune(uint32_t node) {
+        while (node != 0 && nodes[node].itemCount == 0 && nodes[node].childCount == 0) {
+            const uint32_t parent = nodes[node].parent;
+            Node& owner = nodes[parent];
+
+            for (auto& child : owner.children) {
+                if (child == node) child = INVALID;
+            }
+            --owner.childCount;
+            if (!owner.childCount) owner.split = false;
+
+            freeNodes.push_back(node);
+            node = parent;
+        }
+    }
+
+    /**
+     * Pushes every item of node that may go deeper into the child holding its center.
+     * Items the root keeps because their center lies outside the tree bounds stay there,
+     * no child's loose bounds contain them
+     */
+    void splitNode(const uint32_t node) {
+        nodes[node].split = true;
+
+        for (uint32_t item = nodes[node].firstItem; item != INVALID;) {
+            const uint32_t next = slots[item].next;
+            const AABB& aabb = slots[item].value->aabb;
+
+            if (fitDepth(aabb) > nodes[node].depth && (node != 0 || insideRoot(aabb.center))) {
+                unlink(item);
+                link(item, getOrCreateChild(node, childIndex(nodes[node], aabb.center)));
+            }
+            item = next;
+        }
+    }
+
+    uint32_t findNode(const AABB& aabb) {
+        if (!insideRoot(aabb.center)) {
+            return 0;
+        }
+
+        const int target = fitDepth(aabb);
+        uint32_t node = 0;
+
+        while (nodes[node].depth < target) {
+            if (!nodes[node].split) {
+                if (nodes[node].itemCount < static_cast<uint32_t>(nodeCapacity)) break;
+                splitNode(node);
+            }
+            node = getOrCreateChild(node, childIndex(nodes[node], aabb.center));
+        }
+        return node;
+    }
+
+    /* whether an item with aabb may keep living in node, the O(1) path of relocate */
+    bool stays(const uint32_t node, const AABB& aabb) const {
+        const Node& owner = nodes[node];
+
+        if (node == 0 && !insideRoot(aabb.center)) return true;
+        if (!allLessEqual(glm::abs(aabb.center - owner.center), levelHalfSize[owner.depth])) return false;
+
+        const int depth = fitDepth(aabb);
+        return depth == owner.depth || (depth > owner.depth && !owner.split);
+    }
+
+    Slot* resolve(const Handle handle) {
+        if (handle.index >= slots.size()) return nullptr;
+
+        Slot& slot = slots[handle.index];
+        return slot.value && slot.generation == handle.generation ? &slot : nullptr;
+    }
+
+    /* fn(uint32_t node) -> true to skip its subtree, visits nodes whose loose bounds overlap [center +- half] */
+    template <typename Fn>
+    void visit(const glm::vec3& center, const glm::vec3& half, Fn&& fn) {
+        uint32_t stack[(CHILDREN - 1) * MAX_DEPTH + 1];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top) {
+            const uint32_t index = stack[--top];
+            const Node& node = nodes[index];
+
+            // the root also holds whatever lies outside the tree bounds, it is always visited
+            if (index != 0 && !overlaps(node.center, looseHalfSize(node), center, half)) continue;
+            if (fn(index)) continue;
+
+            for (const uint32_t child : node.children) {
+                if (child != INVALID) stack[top++] = child;
+            }
+        }
+    }
+
+    /* calls fn(T&) and turns a void result into "continue" */
+    template <typename Fn>
+    static bool invoke(Fn& fn, T& value) {
+        if constexpr (std::is_invocable_r_v<bool, Fn, T&>) {
+            return fn(value);
+        } else {
+            fn(value);
+            return false;
+        }
+    }
+public:
+    LooseTree() : LooseTree(AABB({}, glm::vec3(1.0f)), 8, 8) {}
+
+    LooseTree(const AABB& bounds, const int size, const int maxDepth) : bounds(bounds), nodeCapacity(size), maxDepth(maxDepth) {
+        cexpr::require(maxDepth <= MAX_DEPTH);
+
+        levelHalfSize[0] = bounds.halfSize;
+        for (int depth = 1; depth <= MAX_DEPTH; ++depth) {
+            levelHalfSize[depth] = levelHalfSize[depth - 1] * 0.5f;
+        }
+        clear();
+    }
+
+    /* x/y bounds, the z extent is ignored by quadtrees */
+    LooseTree(const glm::vec2 min, const glm::vec2 max, const int size = 8, const int maxDepth = 8) requires (Dimensions == 2)
+        : LooseTree(AABB(glm::vec3((min + max) / 2.0f, 0.0f), glm::vec3((max - min) / 2.0f, 0.0f)), size, maxDepth) {}
+
+    Handle insert(const T& item) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+
+        Slot& slot = slots[index];
+        slot.value.emplace(item);
+        link(index, findNode(item.aabb));
+
+        ++count;
+        return { index, slot.generation };
+    }
+
+    template <typename Iterator>
+    void fill(Iterator begin, Iterator end) {
+        for (auto it = begin; it != end; ++it) {
+            insert(*it);
+        }
+    }
+
+    bool remove(const Handle handle) {
+        Slot* slot = resolve(handle);
+        if (!slot) return false;
+
+        const uint32_t node = slot->node;
+        unlink(handle.index);
+        slot->value.reset();
+        ++slot->generation;
+        freeSlots.push_back(handle.index);
+        --count;
+
+        prune(node);
+        return true;
+    }
+
+    /* stores item under handle, O(1) while it stays in its node, otherwise it moves down from the root */
+    bool relocate(const Handle handle, const T& item) {
+        Slot* slot = resolve(handle);
+        if (!slot) return false;
+
+        *slot->value = item;
+
+        const uint32_t node = slot->node;
+        if (stays(node, item.aabb)) {
+            return true;
+        }
+
+        unlink(handle.index);
+        link(handle.index, findNode(item.aabb));
+        prune(node);
+        return true;
+    }
+
+    T* get(const Handle handle) {
+        Slot* slot = resolve(handle);
+        return slot ? &*slot->value : nullptr;
+    }
+
+    bool contains(const Handle handle) {
+        return resolve(handle) != nullptr;
+    }
+
+    /* fn(T&), or bool(T&) returning true to stop */
+    template <typename Fn>
+    void forEachIntersecting(const AABB& aabb, Fn&& fn) {
+        bool stop = false;
+        visit(aabb.center, aabb.halfSize, [&](const uint32_t node) {
+            for (uint32_t item = nodes[node].firstItem; item != INVALID && !stop; item = slots[item].next) {
+                T& value = *slots[item].value;
+                if (value.aabb.intersects(aabb)) stop = invoke(fn, value);
+            }
+            return stop;
+        });
+    }
+
+    /* appends every item whose bounds intersect aabb */
+    void allThatIntersect(const AABB& aabb, std::vector<T*>& result) {
+        forEachIntersecting(aabb, [&](T& value) { result.push_back(&value); });
+    }
+
+    /* appends every item whose bounds contain aabb */
+    void allThatFit(const AABB& aabb, std::vector<T*>& result) {
+        visit(aabb.center, aabb.halfSize, [&](const uint32_t node) {
+            for (uint32_t item = nodes[node].firstItem; item != INVALID; item = slots[item].next) {
+                T& value = *slots[item].value;
+                if (value.aabb.contains(aabb)) result.push_back(&value);
+            }
+            return false;
+        });
+    }
+
+    /* fn(T&), or bool(T&) returning true to stop, for every item whose bounds hold point */
+    template <typename Fn>
+    void forEachContaining(const glm::vec3& point, Fn&& fn) {
+        bool stop = false;
+        visit(point, glm::vec3(0.0f), [&](const uint32_t node) {
+            for (uint32_t item = nodes[node].firstItem; item != INVALID && !stop; item = slots[item].next) {
+                T& value = *slots[item].value;
+                if (value.aabb.contains(point)) stop = invoke(fn, value);
+            }
+            return stop;
+        });
+    }
+
+    /* fn(const RayResult&, T&), or bool(...) returning true to stop, in no particular order */
+    template <typename Fn>
+    void raycast(const Ray& ray, Fn&& fn) {
+        const glm::vec3 end = ray.getPoint(ray.length);
+        const glm::vec3 center = (ray.origin + end) * 0.5f;
+        const glm::vec3 half = glm::abs(end - ray.origin) * 0.5f;
+        bool stop = false;
+
+        visit(center, half, [&](const uint32_t node) {
+            const Node& owner = nodes[node];
+            if (node != 0 && !ray.intersectsSlab(looseRayBounds(owner))) return true;
+
+            for (uint32_t item = owner.firstItem; item != INVALID && !stop; item = slots[item].next) {
+                T& value = *slots[item].value;
+                if (const RayResult result = ray.intersects(value.aabb); result.hasHit()) {
+                    if constexpr (std::is_invocable_r_v<bool, Fn, const RayResult&, T&>) {
+                        stop = fn(result, value);
+                    } else {
+                        fn(result, value);
+                    }
+                }
+            }
+            return stop;
+        });
+    }
+
+    /* appends every hit of ray */
+    void raycast(const Ray& ray, std::vector<std::pair<RayResult, T*>>& result) {
+        raycast(ray, [&](const RayResult& hit, T& value) { result.emplace_back(hit, &value); });
+    }
+
+    template <typename Fn>
+    requires std::is_invocable_r_v<void, Fn, T&>
+    void forEach(Fn&& fn) {
+        for (auto& slot : slots) {
+            if (slot.value) fn(*slot.value);
+        }
+    }
+
+    template <typename Fn>
+    /**
+     * fn(const AABB& looseBounds, unsigned depth, unsigned itemCount)
+     * return true -> skips children
+     * return false -> continues
+     */
+    void onEachNode(Fn&& fn) {
+        uint32_t stack[(CHILDREN - 1) * MAX_DEPTH + 1];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top) {
+            const Node& node = nodes[stack[--top]];
+            const AABB loose(node.center, looseHalfSize(node));
+
+            if constexpr (std::is_invocable_r_v<bool, Fn, const AABB&, unsigned, unsigned>) {
+                if (fn(loose, node.depth, node.itemCount)) continue;
+            } else {
+                fn(loose, node.depth, node.itemCount);
+            }
+
+            for (const uint32_t child : node.children) {
+                if (child != INVALID) stack[top++] = child;
+            }
+        }
+    }
+
+    const AABB& getBounds() const {
+        return bounds;
+    }
+
+    size_t nodeCount() const {
+        return nodes.size() - freeNodes.size();
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return !count;
+    }
+
+    void clear() {
+        nodes.clear();
+        freeNodes.clear();
+        slots.clear();
+        freeSlots.clear();
+        count = 0;
+
+        nodes.emplace_back();
+        nodes[0].center = bounds.center;
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <glm/glm.hpp>
+#include <constexpr/assert.h>
+#include "Ray.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RAY_PACKET_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define RAY_PACKET_SSE 1
+#endif
+
+/**
+ * Up to 8 rays split into one array per component, with their reciprocal directions precomputed,
+ * the layout the batched slab test reads. Unused lanes never hit anything.
+ * Packets pay off when their rays are coherent: close origins and similar directions
+ */
+struct alignas(32) RayPacket {
+    constexpr static int SIZE = 8;
+
+    float originX[SIZE];
+    float originY[SIZE];
+    float originZ[SIZE];
+    float invDirX[SIZE];
+    float invDirY[SIZE];
+    float invDirZ[SIZE];
+    Ray rays[SIZE];
+    uint32_t count = 0;
+
+    RayPacket() = default;
+
+    explicit RayPacket(const std::span<const Ray> source) {
+        cexpr::require(source.size() <= SIZE);
+        count = static_cast<uint32_t>(source.size());
+
+        for (uint32_t i = 0; i < SIZE; ++i) {
+            const Ray ray = i < count ? source[i] : Ray(glm::vec3(0.0f), glm::vec3(1.0f), -1.0f);
+            rays[i] = ray;
+
+            originX[i] = ray.origin.x;
+            originY[i] = ray.origin.y;
+            originZ[i] = ray.origin.z;
+            invDirX[i] = reciprocal(ray.direction.x);
+            invDirY[i] = reciprocal(ray.direction.y);
+            invDirZ[i] = reciprocal(ray.direction.z);
+        }
+    }
+
+    /* finite even for axis parallel rays, a ray lying on a slab face then gets 0 instead of 0 * inf = NaN */
+    static float reciprocal(const float d) {
+        const float inv = 1.0f / d;
+        return std::isfinite(inv) ? inv : std::copysign(std::numeric_limits<float>::max(), d);
+    }
+
+    /* bit i is set for every ray the packet holds */
+    uint32_t mask() const {
+        return (1u << count) - 1u;
+    }
+
+    /* bit i of the result is set when ray i enters [min, max] between 0 and tFar[i], tFar holds SIZE distances */
+    uint32_t intersectsSlab(const glm::vec3& min, const glm::vec3& max, const float* tFar) const {
+#if defined(RAY_PACKET_AVX)
+        const auto axis = [](const float* origin, const float* invDir, const float lo, const float hi, __m256& enter, __m256& exit) {
+            const __m256 o = _mm256_load_ps(origin);
+            const __m256 inv = _mm256_load_ps(invDir);
+            const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(lo), o), inv);
+            const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hi), o), inv);
+
+            enter = _mm256_max_ps(_mm256_min_ps(t0, t1), enter);
+            exit = _mm256_min_ps(_mm256_max_ps(t0, t1), exit);
+        };
+
+        __m256 enter = _mm256_setzero_ps();
+        __m256 exit = _mm256_loadu_ps(tFar);
+
+        axis(originX, invDirX, min.x, max.x, enter, exit);
+        axis(originY, invDirY, min.y, max.y, enter, exit);
+        axis(originZ, invDirZ, min.z, max.z, enter, exit);
+
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ))) & mask();
+#elif defined(RAY_PACKET_SSE)
+        uint32_t hits = 0;
+
+        for (int half = 0; half < SIZE; half += 4) {
+            const auto axis = [&](const float* origin, const float* invDir, const float lo, const float hi, __m128& enter, __m128& exit) {
+                const __m128 o = _mm_load_ps(origin + half);
+                const __m128 inv = _mm_load_ps(invDir + half);
+                const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo), o), inv);
+                const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi), o), inv);
+
+                enter = _mm_max_ps(_mm_min_ps(t0, t1), enter);
+                exit = _mm_min_ps(_mm_max_ps(t0, t1), exit);
+            };
+
+            __m128 enter = _mm_setzero_ps();
+            __m128 exit = _mm_loadu_ps(tFar + half);
+
+            axis(originX, invDirX, min.x, max.x, enter, exit);
+            axis(originY, invDirY, min.y, max.y, enter, exit);
+            axis(originZ, invDirZ, min.z, max.z, enter, exit);
+
+            hits |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit))) << half;
+        }
+        return hits & mask();
+#else
+        uint32_t hits = 0;
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const float origin[3] = { originX[i], originY[i], originZ[i] };
+            const float invDir[3] = { invDirX[i], invDirY[i], invDirZ[i] };
+
+            float enter = 0.0f;
+            float exit = tFar[i];
+
+            for (int a = 0; a < 3; ++a) {
+                const float t0 = (min[a] - origin[a]) * invDir[a];
+                const float t1 = (max[a] - origin[a]) * invDir[a];
+                const float closest = std::min(t0, t1);
+                const float farthest = std::max(t0, t1);
+
+                enter = std::max(enter, closest);
+                exit = std::min(exit, farthest);
+            }
+            hits |= static_cast<uint32_t>(enter <= exit) << i;
+        }
+        return hits;
+#endif
+    }
+};
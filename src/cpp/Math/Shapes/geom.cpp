@@ -120,6 +120,7 @@ bool geom::intersects(const OOBB &oobb1, const OOBB &oobb2) {
 }
 
 bool geom::intersects(const Capsule &cap1, const Capsule &cap2) {
+    constexpr float EPSILON = 1e-12f;
     const glm::vec3 d1 = cap1.p2 - cap1.p1;
     const glm::vec3 d2 = cap2.p2 - cap2.p1;
     const glm::vec3 r = cap1.p1 - cap2.p1;
@@ -130,23 +131,30 @@ bool geom::intersects(const Capsule &cap1, const Capsule &cap2) {
     float sVal = 0.0f;
     float tVal = 0.0f;
 
-    const float c = glm::dot(d1, r);
-    const float b = glm::dot(d1, d2);
-
-    if (const float denom = a * e - b * b; denom != 0.0f) {
-        sVal = glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f);
-    }
-    tVal = (b * sVal + f) / e;
-
-    if (tVal < 0.0f) {
-        tVal = 0.0f;
+    if (a <= EPSILON && e <= EPSILON) {
+        // both segments are points
+    } else if (a <= EPSILON) {
+        tVal = glm::clamp(f / e, 0.0f, 1.0f);
+    } else if (const float c = glm::dot(d1, r); e <= EPSILON) {
         sVal = glm::clamp(-c / a, 0.0f, 1.0f);
-    } else if (tVal > 1.0f) {
-        tVal = 1.0f;
-        sVal = glm::clamp((b - c) / a, 0.0f, 1.0f);
+    } else {
+        const float b = glm::dot(d1, d2);
+
+        if (const float denom = a * e - b * b; denom != 0.0f) {
+            sVal = glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f);
+        }
+        tVal = (b * sVal + f) / e;
+
+        if (tVal < 0.0f) {
+            tVal = 0.0f;
+            sVal = glm::clamp(-c / a, 0.0f, 1.0f);
+        } else if (tVal > 1.0f) {
+            tVal = 1.0f;
+            sVal = glm::clamp((b - c) / a, 0.0f, 1.0f);
+        }
     }
     const glm::vec3 c1 = cap1.p1 + d1 * sVal;
-    const glm::vec3 c2 = cap1.p2 + d2 * tVal;
+    const glm::vec3 c2 = cap2.p1 + d2 * tVal;
     const float radiusSum = cap1.radius + cap2.radius;
     return glm::length2(c1 - c2) <= radiusSum * radiusSum;
 }
@@ -204,7 +212,7 @@ geom::MTVResult geom::mtv(const OOBB &oobb1, const OOBB &oobb2) {
         if (glm::length2(axis) < 1e-6f) continue;
 
         const float aProj = projectExtent(oobb1, axis);
-        const float bProj = projectExtent(oobb1, axis);
+        const float bProj = projectExtent(oobb2, axis);
         const float dist = std::abs(glm::dot(delta, axis));
         const float overlap = aProj + bProj - dist;
 
@@ -303,18 +311,11 @@ AABB geom::inverse_transform(const AABB &aabb, const glm::mat4 &transform) {
 
 AABB geom::transformer::operator()(const AABB &aabb, const glm::mat4 &worldTransform) const
 {
-    auto corners = aabb.corners();
-
-    glm::vec3 newMin(std::numeric_limits<float>::max());
-    glm::vec3 newMax(std::numeric_limits<float>::lowest());
+    // abs matrix method, the same box as transforming all 8 corners for affine transforms
+    const glm::mat3 linear(worldTransform);
+    const glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
 
-    for (const glm::vec3& corner : corners) {
-        glm::vec3 transformed = glm::vec3(worldTransform * glm::vec4(corner, 1.0f));
-        newMin = glm::min(newMin, transformed);
-        newMax = glm::max(newMax, transformed);
-    }
-
-    return AABB::fromTo(newMin, newMax);
+    return {linear * aabb.center + glm::vec3(worldTransform[3]), absLinear * aabb.halfSize};
 }
 
 AABB geom::transformer::operator()(const AABB &aabb, const glm::vec3 &position, const glm::vec3 &scale) const
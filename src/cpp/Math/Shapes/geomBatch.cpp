@@ -0,0 +1,387 @@
+#include "geomBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <constexpr/assert.h>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GEOM_BATCH_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define GEOM_BATCH_SSE 1
+#endif
+
+namespace {
+    /**
+     * Kernels are written once against a lane type, Wide runs them over a full register of pairs,
+     * Narrow over the remaining pairs one at a time. Comparisons return masks of the same type
+     */
+#if defined(GEOM_BATCH_AVX)
+    struct Wide {
+        constexpr static int WIDTH = 8;
+        __m256 v;
+
+        static Wide load(const float* p) { return { _mm256_loadu_ps(p) }; }
+        static Wide broadcast(const float f) { return { _mm256_set1_ps(f) }; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+    };
+
+    inline Wide operator+(const Wide a, const Wide b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline Wide operator-(const Wide a, const Wide b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline Wide operator*(const Wide a, const Wide b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    inline Wide operator/(const Wide a, const Wide b) { return { _mm256_div_ps(a.v, b.v) }; }
+    inline Wide operator<(const Wide a, const Wide b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline Wide operator>(const Wide a, const Wide b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline Wide operator<=(const Wide a, const Wide b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline Wide operator&(const Wide a, const Wide b) { return { _mm256_and_ps(a.v, b.v) }; }
+    inline Wide min(const Wide a, const Wide b) { return { _mm256_min_ps(a.v, b.v) }; }
+    inline Wide max(const Wide a, const Wide b) { return { _mm256_max_ps(a.v, b.v) }; }
+    inline Wide sqrt(const Wide a) { return { _mm256_sqrt_ps(a.v) }; }
+    inline Wide abs(const Wide a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+    inline Wide select(const Wide mask, const Wide a, const Wide b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+    inline uint32_t bits(const Wide mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask.v)); }
+#elif defined(GEOM_BATCH_SSE)
+    struct Wide {
+        constexpr static int WIDTH = 4;
+        __m128 v;
+
+        static Wide load(const float* p) { return { _mm_loadu_ps(p) }; }
+        static Wide broadcast(const float f) { return { _mm_set1_ps(f) }; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+    };
+
+    inline Wide operator+(const Wide a, const Wide b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline Wide operator-(const Wide a, const Wide b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline Wide operator*(const Wide a, const Wide b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline Wide operator/(const Wide a, const Wide b) { return { _mm_div_ps(a.v, b.v) }; }
+    inline Wide operator<(const Wide a, const Wide b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    inline Wide operator>(const Wide a, const Wide b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline Wide operator<=(const Wide a, const Wide b) { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline Wide operator&(const Wide a, const Wide b) { return { _mm_and_ps(a.v, b.v) }; }
+    inline Wide min(const Wide a, const Wide b) { return { _mm_min_ps(a.v, b.v) }; }
+    inline Wide max(const Wide a, const Wide b) { return { _mm_max_ps(a.v, b.v) }; }
+    inline Wide sqrt(const Wide a) { return { _mm_sqrt_ps(a.v) }; }
+    inline Wide abs(const Wide a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    inline Wide select(const Wide mask, const Wide a, const Wide b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+    inline uint32_t bits(const Wide mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.v)); }
+#endif
+
+    /* one pair, masks are 1 or 0 */
+    struct Narrow {
+        constexpr static int WIDTH = 1;
+        float v;
+
+        static Narrow load(const float* p) { return { *p }; }
+        static Narrow broadcast(const float f) { return { f }; }
+        void store(float* p) const { *p = v; }
+    };
+
+    inline Narrow operator+(const Narrow a, const Narrow b) { return { a.v + b.v }; }
+    inline Narrow operator-(const Narrow a, const Narrow b) { return { a.v - b.v }; }
+    inline Narrow operator*(const Narrow a, const Narrow b) { return { a.v * b.v }; }
+    inline Narrow operator/(const Narrow a, const Narrow b) { return { a.v / b.v }; }
+    inline Narrow operator<(const Narrow a, const Narrow b) { return { a.v < b.v ? 1.0f : 0.0f }; }
+    inline Narrow operator>(const Narrow a, const Narrow b) { return { a.v > b.v ? 1.0f : 0.0f }; }
+    inline Narrow operator<=(const Narrow a, const Narrow b) { return { a.v <= b.v ? 1.0f : 0.0f }; }
+    inline Narrow operator&(const Narrow a, const Narrow b) { return { a.v != 0.0f && b.v != 0.0f ? 1.0f : 0.0f }; }
+    inline Narrow min(const Narrow a, const Narrow b) { return { std::min(a.v, b.v) }; }
+    inline Narrow max(const Narrow a, const Narrow b) { return { std::max(a.v, b.v) }; }
+    inline Narrow sqrt(const Narrow a) { return { std::sqrt(a.v) }; }
+    inline Narrow abs(const Narrow a) { return { std::abs(a.v) }; }
+    inline Narrow select(const Narrow mask, const Narrow a, const Narrow b) { return mask.v != 0.0f ? a : b; }
+    inline uint32_t bits(const Narrow mask) { return mask.v != 0.0f; }
+
+    template <typename V>
+    V clamp01(const V x) {
+        return min(max(x, V::broadcast(0.0f)), V::broadcast(1.0f));
+    }
+
+    /* per lane winner of the SAT axes, only filled when MTVs are requested */
+    template <typename V>
+    struct SeparatingAxis {
+        V depth = V::broadcast(std::numeric_limits<float>::max());
+        V index = V::broadcast(0.0f);
+        V side = V::broadcast(1.0f);
+
+        void consider(const V overlap, const float axis, const V projection) {
+            const V better = overlap < depth;
+            depth = select(better, overlap, depth);
+            index = select(better, V::broadcast(axis), index);
+            side = select(better, projection, side);
+        }
+    };
+
+    /**
+     * intersects(OOBB, OOBB) lane wise, the 15 axes are tested in the frame of a.
+     * With an axis the smallest overlap along the normalized axes is tracked like mtv(OOBB, OOBB) does
+     */
+    template <typename V, bool WITH_AXIS>
+    V satPairs(const geom::OOBBStream& a, const geom::OOBBStream& b, const size_t i, SeparatingAxis<V>* axis) {
+        constexpr float EPSILON = 1e-6f;
+        constexpr float PARALLEL = 1e-3f;
+
+        V A[3][3], B[3][3], ha[3], hb[3], d[3];
+        for (int c = 0; c < 3; ++c) {
+            ha[c] = V::load(&a.halfSize[c][i]);
+            hb[c] = V::load(&b.halfSize[c][i]);
+            d[c] = V::load(&b.center[c][i]) - V::load(&a.center[c][i]);
+            for (int k = 0; k < 3; ++k) {
+                A[k][c] = V::load(&a.axis[k][c][i]);
+                B[k][c] = V::load(&b.axis[k][c][i]);
+            }
+        }
+
+        V R[3][3], AbsR[3][3], t[3];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                R[r][c] = A[r][0] * B[c][0] + A[r][1] * B[c][1] + A[r][2] * B[c][2];
+                AbsR[r][c] = abs(R[r][c]) + V::broadcast(EPSILON);
+            }
+            t[r] = d[0] * A[r][0] + d[1] * A[r][1] + d[2] * A[r][2];
+        }
+
+        V hit = V::broadcast(0.0f) <= V::broadcast(1.0f);
+        const auto test = [&](const V projection, const V radius, const V length, const float index) {
+            hit = hit & (abs(projection) <= radius);
+            if constexpr (WITH_AXIS) {
+                axis->consider((radius - abs(projection)) / length, index, projection);
+            }
+        };
+        const V one = V::broadcast(1.0f);
+
+        for (int r = 0; r < 3; ++r) {
+            test(t[r], ha[r] + hb[0] * AbsR[r][0] + hb[1] * AbsR[r][1] + hb[2] * AbsR[r][2], one, static_cast<float>(r));
+        }
+        for (int c = 0; c < 3; ++c) {
+            const V projection = t[0] * R[0][c] + t[1] * R[1][c] + t[2] * R[2][c];
+            test(projection, ha[0] * AbsR[0][c] + ha[1] * AbsR[1][c] + ha[2] * AbsR[2][c] + hb[c], one, static_cast<float>(3 + c));
+        }
+        for (int r = 0; r < 3; ++r) {
+            const int r1 = (r + 1) % 3;
+            const int r2 = (r + 2) % 3;
+
+            for (int c = 0; c < 3; ++c) {
+                const int c1 = (c + 1) % 3;
+                const int c2 = (c + 2) % 3;
+
+                const V radius = ha[r1] * AbsR[r2][c] + ha[r2] * AbsR[r1][c] + hb[c1] * AbsR[r][c2] + hb[c2] * AbsR[r][c1];
+                const V projection = t[r2] * R[r1][c] - t[r1] * R[r2][c];
+                hit = hit & (abs(projection) <= radius);
+
+                if constexpr (WITH_AXIS) {
+                    // |a_r x b_c| = sin of their angle, near parallel edges leave no usable axis
+                    const V length = sqrt(max(one - R[r][c] * R[r][c], V::broadcast(0.0f)));
+                    const V usable = V::broadcast(PARALLEL) < length;
+                    const V overlap = select(usable, (radius - abs(projection)) / max(length, V::broadcast(PARALLEL)), V::broadcast(std::numeric_limits<float>::max()));
+                    axis->consider(overlap, static_cast<float>(6 + r * 3 + c), projection);
+                }
+            }
+        }
+        return hit;
+    }
+
+    /* world space direction of SAT axis index for pair i, pointing from a to b */
+    geom::MTVResult satResult(const geom::OOBBStream& a, const geom::OOBBStream& b, const size_t i, const int index, const float depth, const float side) {
+        const auto column = [i](const geom::OOBBStream& stream, const int k) {
+            return glm::vec3(stream.axis[k][0][i], stream.axis[k][1][i], stream.axis[k][2][i]);
+        };
+
+        glm::vec3 direction;
+        if (index < 3) direction = column(a, index);
+        else if (index < 6) direction = column(b, index - 3);
+        else direction = glm::normalize(glm::cross(column(a, (index - 6) / 3), column(b, (index - 6) % 3)));
+
+        return { side < 0.0f ? -direction : direction, depth };
+    }
+
+    /* closest points of both segments lane wise, like intersects(Capsule, Capsule) */
+    template <typename V>
+    V capsulePairs(const geom::CapsuleStream& a, const geom::CapsuleStream& b, const size_t i, V (&delta)[3], V& distanceSquared, V& radiusSum) {
+        constexpr float EPSILON = 1e-12f;
+        const V zero = V::broadcast(0.0f);
+        const V epsilon = V::broadcast(EPSILON);
+
+        V p1[3], q1[3], d1[3], d2[3], r[3];
+        for (int c = 0; c < 3; ++c) {
+            p1[c] = V::load(&a.p1[c][i]);
+            q1[c] = V::load(&b.p1[c][i]);
+            d1[c] = V::load(&a.p2[c][i]) - p1[c];
+            d2[c] = V::load(&b.p2[c][i]) - q1[c];
+            r[c] = p1[c] - q1[c];
+        }
+        const auto dot = [](const V (&x)[3], const V (&y)[3]) {
+            return x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+        };
+
+        const V A = dot(d1, d1);
+        const V E = dot(d2, d2);
+        const V F = dot(d2, r);
+        const V C = dot(d1, r);
+        const V B = dot(d1, d2);
+        const V pointA = A <= epsilon;
+        const V pointB = E <= epsilon;
+
+        // divisions by zero only land in lanes a select below discards
+        const V denom = A * E - B * B;
+        V s = select(zero < denom, clamp01((B * F - C * E) / denom), zero);
+        V t = (B * s + F) / E;
+        s = select(t < zero, clamp01((zero - C) / A), select(V::broadcast(1.0f) < t, clamp01((B - C) / A), s));
+        t = clamp01(t);
+
+        s = select(pointB, clamp01((zero - C) / A), s);
+        t = select(pointA, clamp01(F / E), t);
+        s = select(pointA, zero, s);
+        t = select(pointB, zero, t);
+
+        for (int c = 0; c < 3; ++c) {
+            delta[c] = (q1[c] + d2[c] * t) - (p1[c] + d1[c] * s);
+        }
+        distanceSquared = dot(delta, delta);
+        radiusSum = V::load(&a.radius[i]) + V::load(&b.radius[i]);
+        return distanceSquared <= radiusSum * radiusSum;
+    }
+
+    geom::MTVResult capsuleResult(const glm::vec3 delta, const float distanceSquared, const float radiusSum) {
+        const float distance = std::sqrt(distanceSquared);
+        const glm::vec3 direction = distance > 1e-6f ? delta / distance : glm::vec3(0, 1, 0);
+        return { direction, radiusSum - distance };
+    }
+
+    /* boxes per task of a parallel transformBounds, smaller batches stay on the calling thread */
+    constexpr size_t TRANSFORM_GRAIN = 2048;
+
+    void transformRange(const AABB* local, const glm::mat4* transforms, AABB* world, const size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const glm::mat4& m = transforms[i];
+            const glm::vec3 c = local[i].center;
+            const glm::vec3 h = local[i].halfSize;
+#if defined(GEOM_BATCH_AVX) || defined(GEOM_BATCH_SSE)
+            // one matrix column per register, w lanes are computed and dropped
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            const __m128 c0 = _mm_loadu_ps(&m[0][0]);
+            const __m128 c1 = _mm_loadu_ps(&m[1][0]);
+            const __m128 c2 = _mm_loadu_ps(&m[2][0]);
+            const __m128 c3 = _mm_loadu_ps(&m[3][0]);
+
+            const __m128 center = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(c.x)), _mm_mul_ps(c1, _mm_set1_ps(c.y))),
+                _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(c.z)), c3));
+            const __m128 half = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_and_ps(c0, absMask), _mm_set1_ps(h.x)), _mm_mul_ps(_mm_and_ps(c1, absMask), _mm_set1_ps(h.y))),
+                _mm_mul_ps(_mm_and_ps(c2, absMask), _mm_set1_ps(h.z)));
+
+            float out[8];
+            _mm_storeu_ps(out, center);
+            _mm_storeu_ps(out + 4, half);
+            std::memcpy(&world[i].center, out, sizeof(glm::vec3));
+            std::memcpy(&world[i].halfSize, out + 4, sizeof(glm::vec3));
+#else
+            const glm::mat3 linear(m);
+            const glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+
+            world[i] = AABB(linear * c + glm::vec3(m[3]), absLinear * h);
+#endif
+        }
+    }
+
+    /**
+     * runs block(i, V) over [0, count) a register of pairs at a time and the tail one by one,
+     * block returns the hit mask of pairs [i, i + V::WIDTH)
+     */
+    template <typename Block>
+    void forEachBlock(const size_t count, const std::span<uint32_t> hits, Block&& block) {
+        cexpr::require(hits.size() >= geom::maskWords(count));
+        std::fill(hits.begin(), hits.begin() + geom::maskWords(count), 0u);
+
+        size_t i = 0;
+#if defined(GEOM_BATCH_AVX) || defined(GEOM_BATCH_SSE)
+        // WIDTH divides 32, a block never straddles two words
+        for (; i + Wide::WIDTH <= count; i += Wide::WIDTH) {
+            hits[i / 32] |= bits(block(i, Wide{})) << (i % 32);
+        }
+#endif
+        for (; i < count; ++i) {
+            hits[i / 32] |= bits(block(i, Narrow{})) << (i % 32);
+        }
+    }
+}
+
+void geom::intersects(const OOBBStream& a, const OOBBStream& b, const std::span<uint32_t> hits) {
+    cexpr::require(a.size() == b.size());
+
+    forEachBlock(a.size(), hits, [&]<typename V>(const size_t i, V) {
+        return satPairs<V, false>(a, b, i, nullptr);
+    });
+}
+
+void geom::mtv(const OOBBStream& a, const OOBBStream& b, const std::span<uint32_t> hits, const std::span<MTVResult> results) {
+    cexpr::require(a.size() == b.size() && results.size() >= a.size());
+
+    forEachBlock(a.size(), hits, [&]<typename V>(const size_t i, V) {
+        SeparatingAxis<V> axis;
+        const V hit = satPairs<V, true>(a, b, i, &axis);
+
+        float depth[V::WIDTH], index[V::WIDTH], side[V::WIDTH];
+        axis.depth.store(depth);
+        axis.index.store(index);
+        axis.side.store(side);
+
+        const uint32_t mask = bits(hit);
+        for (int lane = 0; lane < V::WIDTH; ++lane) {
+            results[i + lane] = mask >> lane & 1u
+                ? satResult(a, b, i + lane, static_cast<int>(index[lane]), depth[lane], side[lane])
+                : MTVResult{ glm::vec3(0), 0.0f };
+        }
+        return hit;
+    });
+}
+
+void geom::intersects(const CapsuleStream& a, const CapsuleStream& b, const std::span<uint32_t> hits) {
+    cexpr::require(a.size() == b.size());
+
+    forEachBlock(a.size(), hits, [&]<typename V>(const size_t i, V) {
+        V delta[3], distanceSquared, radiusSum;
+        return capsulePairs<V>(a, b, i, delta, distanceSquared, radiusSum);
+    });
+}
+
+void geom::mtv(const CapsuleStream& a, const CapsuleStream& b, const std::span<uint32_t> hits, const std::span<MTVResult> results) {
+    cexpr::require(a.size() == b.size() && results.size() >= a.size());
+
+    forEachBlock(a.size(), hits, [&]<typename V>(const size_t i, V) {
+        V delta[3], distanceSquared, radiusSum;
+        const V hit = capsulePairs<V>(a, b, i, delta, distanceSquared, radiusSum);
+
+        float dx[V::WIDTH], dy[V::WIDTH], dz[V::WIDTH], dd[V::WIDTH], rs[V::WIDTH];
+        delta[0].store(dx);
+        delta[1].store(dy);
+        delta[2].store(dz);
+        distanceSquared.store(dd);
+        radiusSum.store(rs);
+
+        const uint32_t mask = bits(hit);
+        for (int lane = 0; lane < V::WIDTH; ++lane) {
+            results[i + lane] = mask >> lane & 1u
+                ? capsuleResult(glm::vec3(dx[lane], dy[lane], dz[lane]), dd[lane], rs[lane])
+                : MTVResult{ glm::vec3(0), 0.0f };
+        }
+        return hit;
+    });
+}
+
+void geom::transformBounds(const std::span<const AABB> local, const std::span<const glm::mat4> transforms, const std::span<AABB> world, const bool parallel) {
+    cexpr::require(local.size() == transforms.size() && world.size() >= local.size());
+
+    if (!parallel || local.size() < 2 * TRANSFORM_GRAIN) {
+        transformRange(local.data(), transforms.data(), world.data(), local.size());
+        return;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, local.size(), TRANSFORM_GRAIN), [&](const tbb::blocked_range<size_t>& range) {
+        transformRange(local.data() + range.begin(), transforms.data() + range.begin(), world.data() + range.begin(), range.size());
+    });
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "geom.h"
+
+/**
+ * Geometry kernels over arrays. Narrow phase tests take many candidate pairs at once, shapes are stored
+ * one array per scalar, pair i is (a[i], b[i]) and is evaluated 8 (AVX) or 4 (SSE) pairs per instruction.
+ * Results are bitmasks, bit i % 32 of word i / 32 is set when pair i intersects
+ */
+namespace geom {
+    struct OOBBStream {
+        std::vector<float> center[3];
+        std::vector<float> halfSize[3];
+        /* axis[a][c], component c of orientation column a */
+        std::vector<float> axis[3][3];
+
+        void push_back(const OOBB& oobb) {
+            for (int c = 0; c < 3; ++c) {
+                center[c].push_back(oobb.center[c]);
+                halfSize[c].push_back(oobb.halfSize[c]);
+                for (int a = 0; a < 3; ++a) {
+                    axis[a][c].push_back(oobb.orientation[a][c]);
+                }
+            }
+        }
+
+        OOBB operator[](const size_t i) const {
+            glm::mat3 orientation;
+            for (int a = 0; a < 3; ++a) {
+                orientation[a] = glm::vec3(axis[a][0][i], axis[a][1][i], axis[a][2][i]);
+            }
+            return {
+                glm::vec3(center[0][i], center[1][i], center[2][i]),
+                glm::vec3(halfSize[0][i], halfSize[1][i], halfSize[2][i]),
+                orientation
+            };
+        }
+
+        void reserve(const size_t count) {
+            for (int c = 0; c < 3; ++c) {
+                center[c].reserve(count);
+                halfSize[c].reserve(count);
+                for (auto& a : axis) a[c].reserve(count);
+            }
+        }
+
+        void clear() {
+            for (int c = 0; c < 3; ++c) {
+                center[c].clear();
+                halfSize[c].clear();
+                for (auto& a : axis) a[c].clear();
+            }
+        }
+
+        size_t size() const {
+            return center[0].size();
+        }
+    };
+
+    struct CapsuleStream {
+        std::vector<float> p1[3];
+        std::vector<float> p2[3];
+        std::vector<float> radius;
+
+        void push_back(const Capsule& capsule) {
+            for (int c = 0; c < 3; ++c) {
+                p1[c].push_back(capsule.p1[c]);
+                p2[c].push_back(capsule.p2[c]);
+            }
+            radius.push_back(capsule.radius);
+        }
+
+        Capsule operator[](const size_t i) const {
+            return {
+                glm::vec3(p1[0][i], p1[1][i], p1[2][i]),
+                glm::vec3(p2[0][i], p2[1][i], p2[2][i]),
+                radius[i]
+            };
+        }
+
+        void reserve(const size_t count) {
+            for (int c = 0; c < 3; ++c) {
+                p1[c].reserve(count);
+                p2[c].reserve(count);
+            }
+            radius.reserve(count);
+        }
+
+        void clear() {
+            for (int c = 0; c < 3; ++c) {
+                p1[c].clear();
+                p2[c].clear();
+            }
+            radius.clear();
+        }
+
+        size_t size() const {
+            return radius.size();
+        }
+    };
+
+    /* words needed to hold one bit per pair */
+    constexpr size_t maskWords(const size_t pairs) {
+        return (pairs + 31) / 32;
+    }
+
+    inline bool hasHit(const std::span<const uint32_t> hits, const size_t pair) {
+        return hits[pair / 32] >> (pair % 32) & 1u;
+    }
+
+    /* same test as intersects(OOBB, OOBB) for every pair, hits holds maskWords(a.size()) words */
+    MATHAPI void intersects(const OOBBStream& a, const OOBBStream& b, std::span<uint32_t> hits);
+    /* also writes the MTV pushing b out of a for every pair, { vec3(0), 0 } for misses */
+    MATHAPI void mtv(const OOBBStream& a, const OOBBStream& b, std::span<uint32_t> hits, std::span<MTVResult> results);
+
+    /* same test as intersects(Capsule, Capsule) for every pair */
+    MATHAPI void intersects(const CapsuleStream& a, const CapsuleStream& b, std::span<uint32_t> hits);
+    /* also writes the MTV pushing b out of a along the closest points of both segments */
+    MATHAPI void mtv(const CapsuleStream& a, const CapsuleStream& b, std::span<uint32_t> hits, std::span<MTVResult> results);
+
+    /**
+     * world[i] = transform(local[i], transforms[i]) for affine transforms with the abs matrix method,
+     * the center goes through the matrix and the half size through the absolute values of its linear part.
+     * Large batches are split over the TBB pool
+     */
+    MATHAPI void transformBounds(std::span<const AABB> local, std::span<const glm::mat4> transforms, std::span<AABB> world, bool parallel = true);
+}
@@ -0,0 +1,250 @@
+#pragma once
+#include "Shapes/AABB.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <constexpr/assert.h>
+#include <oneapi/tbb/parallel_for.h>
+
+/**
+ * Sort and sweep broadphase over AABB proxies. Every enabled axis keeps its proxies sorted by their min,
+ * bounds change little from frame to frame so an insertion sort puts them back in order in near linear time.
+ * Pairs are found by sweeping the enabled axis whose proxy centers are spread the most, each proxy is tested
+ * only against those that start before it ends along that axis
+ */
+class SweepAndPrune {
+public:
+    using Pair = std::pair<uint32_t, uint32_t>;
+
+    constexpr static uint8_t AXIS_X = 1 << 0;
+    constexpr static uint8_t AXIS_Y = 1 << 1;
+    constexpr static uint8_t AXIS_Z = 1 << 2;
+    constexpr static uint8_t ALL_AXES = AXIS_X | AXIS_Y | AXIS_Z;
+
+    struct Settings {
+        /* axes kept sorted, with more than one the sweep follows the most spread out of them */
+        uint8_t axes = AXIS_X;
+        /* sweeps large sets in parallel, the pairs come out in the same order either way */
+        bool parallel = true;
+    };
+private:
+    constexpr static size_t PARALLEL_THRESHOLD = 4 * 1024;
+    constexpr static size_t SWEEP_GRAIN = 512;
+
+    struct Proxy {
+        glm::vec3 min{};
+        glm::vec3 max{};
+        bool alive = false;
+    };
+
+    /* endpoints are copied next to the proxy index so the sweep reads one array */
+    struct Entry {
+        float min;
+        float max;
+        uint32_t proxy;
+    };
+
+    Settings settings;
+    std::vector<Proxy> proxies{};
+    std::vector<uint32_t> freeProxies{};
+    /* removed since the last sort, still referenced by the sorted arrays */
+    std::vector<uint32_t> pendingFree{};
+    std::vector<Entry> sorted[3]{};
+    std::vector<std::vector<Pair>> chunkPairs{};
+    size_t count = 0;
+    size_t added = 0;
+
+    bool enabled(const int axis) const {
+        return settings.axes >> axis & 1u;
+    }
+
+    /* refreshes the endpoints of one axis and restores its order */
+    void sortAxis(const int axis) {
+        std::vector<Entry>& entries = sorted[axis];
+
+        if (!pendingFree.empty()) {
+            std::erase_if(entries, [&](const Entry& entry) { return !proxies[entry.proxy].alive; });
+        }
+        for (Entry& entry : entries) {
+            entry.min = proxies[entry.proxy].min[axis];
+            entry.max = proxies[entry.proxy].max[axis];
+        }
+
+        const auto less = [](const Entry& a, const Entry& b) {
+            return a.min < b.min || (a.min == b.min && a.proxy < b.proxy);
+        };
+
+        // a burst of new proxies lands at the back, far from its place, insertion sort would go quadratic
+        if (added * 8 > entries.size()) {
+            std::sort(entries.begin(), entries.end(), less);
+            return;
+        }
+        for (size_t i = 1; i < entries.size(); ++i) {
+            const Entry entry = entries[i];
+            size_t j = i;
+            for (; j > 0 && less(entry, entries[j - 1]); --j) {
+                entries[j] = entries[j - 1];
+            }
+            entries[j] = entry;
+        }
+    }
+
+    /* enabled axis with the largest variance of proxy centers */
+    int sweepAxis() const {
+        int best = -1;
+        float bestVariance = -1.0f;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!enabled(axis)) continue;
+
+            double sum = 0.0, sumSquared = 0.0;
+            for (const Entry& entry : sorted[axis]) {
+                const double center = 0.5 * (static_cast<double>(entry.min) + entry.max);
+                sum += center;
+                sumSquared += center * center;
+            }
+            const double n = static_cast<double>(std::max<size_t>(sorted[axis].size(), 1));
+            const auto variance = static_cast<float>(sumSquared / n - (sum / n) * (sum / n));
+
+            if (variance > bestVariance) {
+                bestVariance = variance;
+                best = axis;
+            }
+        }
+        return best;
+    }
+
+    bool overlaps(const Proxy& a, const Proxy& b) const {
+        return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+               a.min.y <= b.max.y && b.min.y <= a.max.y &&
+               a.min.z <= b.max.z && b.min.z <= a.max.z;
+    }
+
+    /* fn(Pair) for every overlap whose first proxy along the sweep axis is in [start, end) */
+    template <typename Fn>
+    void sweep(const std::vector<Entry>& entries, const size_t start, const size_t end, Fn&& fn) const {
+        for (size_t i = start; i < end; ++i) {
+            const Entry& entry = entries[i];
+            const Proxy& proxy = proxies[entry.proxy];
+
+            for (size_t j = i + 1; j < entries.size() && entries[j].min <= entry.max; ++j) {
+                if (overlaps(proxy, proxies[entries[j].proxy])) {
+                    fn(std::minmax(entry.proxy, entries[j].proxy));
+                }
+            }
+        }
+    }
+public:
+    SweepAndPrune() : SweepAndPrune(Settings{}) {}
+
+    explicit SweepAndPrune(const Settings settings) : settings(settings) {
+        cexpr::require(settings.axes & ALL_AXES);
+    }
+
+    uint32_t insert(const AABB& aabb) {
+        uint32_t index;
+        if (!freeProxies.empty()) {
+            index = freeProxies.back();
+            freeProxies.pop_back();
+        } else {
+            index = static_cast<uint32_t>(proxies.size());
+            proxies.emplace_back();
+        }
+
+        proxies[index] = { aabb.min(), aabb.max(), true };
+        for (int axis = 0; axis < 3; ++axis) {
+            if (enabled(axis)) sorted[axis].push_back({ 0.0f, 0.0f, index });
+        }
+
+        ++count;
+        ++added;
+        return index;
+    }
+
+    /* only stores the new bounds, the order is restored by the next query */
+    void update(const uint32_t proxy, const AABB& aabb) {
+        cexpr::require(proxy < proxies.size() && proxies[proxy].alive);
+        proxies[proxy].min = aabb.min();
+        proxies[proxy].max = aabb.max();
+    }
+
+    void remove(const uint32_t proxy) {
+        cexpr::require(proxy < proxies.size() && proxies[proxy].alive);
+        proxies[proxy].alive = false;
+        pendingFree.push_back(proxy);
+        --count;
+    }
+
+    AABB getBounds(const uint32_t proxy) const {
+        return AABB::fromTo(proxies[proxy].min, proxies[proxy].max);
+    }
+
+    /* brings every enabled axis back in order, done by the queries */
+    void sort() {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (enabled(axis)) sortAxis(axis);
+        }
+        // freed slots may only be reused once no sorted array references them anymore
+        freeProxies.insert(freeProxies.end(), pendingFree.begin(), pendingFree.end());
+        pendingFree.clear();
+        added = 0;
+    }
+
+    /* fn(Pair) for every overlapping pair, pair.first < pair.second */
+    template <typename Fn>
+    void forEachPair(Fn&& fn) {
+        sort();
+        if (const int axis = sweepAxis(); axis >= 0) {
+            sweep(sorted[axis], 0, sorted[axis].size(), fn);
+        }
+    }
+
+    /* replaces pairs with every overlapping pair, large sets are swept in parallel into per chunk buffers */
+    void findPairs(std::vector<Pair>& pairs) {
+        pairs.clear();
+        sort();
+
+        const int axis = sweepAxis();
+        if (axis < 0) return;
+        const std::vector<Entry>& entries = sorted[axis];
+
+        if (!settings.parallel || entries.size() < PARALLEL_THRESHOLD) {
+            sweep(entries, 0, entries.size(), [&](const Pair pair) { pairs.push_back(pair); });
+            return;
+        }
+
+        const size_t chunks = (entries.size() + SWEEP_GRAIN - 1) / SWEEP_GRAIN;
+        chunkPairs.resize(chunks);
+
+        tbb::parallel_for(size_t(0), chunks, [&](const size_t c) {
+            std::vector<Pair>& out = chunkPairs[c];
+            out.clear();
+            sweep(entries, c * SWEEP_GRAIN, std::min(entries.size(), (c + 1) * SWEEP_GRAIN), [&](const Pair pair) { out.push_back(pair); });
+        });
+
+        size_t total = 0;
+        for (size_t c = 0; c < chunks; ++c) total += chunkPairs[c].size();
+        pairs.reserve(total);
+        for (size_t c = 0; c < chunks; ++c) {
+            pairs.insert(pairs.end(), chunkPairs[c].begin(), chunkPairs[c].end());
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return !count;
+    }
+
+    void clear() {
+        proxies.clear();
+        freeProxies.clear();
+        pendingFree.clear();
+        for (auto& entries : sorted) entries.clear();
+        count = 0;
+        added = 0;
+    }
+};
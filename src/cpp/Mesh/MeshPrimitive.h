@@ -41,6 +41,8 @@ namespace mesh {
 
         auto& array = world.createPrimitiveArray<MeshPrimitiveArray>(numPrimitivesReq);
 
+        const auto sections = asset.getMeshSections();
+
         unsigned nextPrimIdx = 0;
         for (auto& meshIndices : asset.getMeshIndices()) {
             for (auto mesh : meshIndices) {
@@ -49,6 +51,7 @@ namespace mesh {
                 primitive->meshSection = mesh;
                 primitive.setLocalBounds(AABB::fromTo(glm::vec3(1), glm::vec3(16)));
                 primitive.getPasses().set<OpaqueRenderingPass>();
+                primitive.setMaterial(sections[mesh].materialIndex);
                 ++nextPrimIdx;
             }
         }
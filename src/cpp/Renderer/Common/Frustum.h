@@ -9,6 +9,14 @@ enum class FrustumPlane {
 };
 
 struct Frustum {
+    constexpr static uint8_t ALL_PLANES = 0x3F;
+
+    enum class Containment {
+        OUTSIDE,
+        INTERSECTS,
+        INSIDE
+    };
+
     glm::vec4 planes[6];
     glm::mat4 view;
     glm::mat4 projection;
@@ -122,6 +130,36 @@ struct Frustum {
         return true;
     }
 
+    /**
+     * Tests box against the planes set in planeMask (bit i is planes[i]) and clears the bits
+     * of the planes the box is fully in front of, children of a box only need the planes left in the mask
+     */
+    Containment classifyAABB(const AABB& box, uint8_t& planeMask) const {
+        for (int i = 0; i < 6; ++i) {
+            const uint8_t bit = static_cast<uint8_t>(1u << i);
+
+            if (!(planeMask & bit)) {
+                continue;
+            }
+            const glm::vec4& plane = planes[i];
+
+            const float s = glm::dot(glm::vec3(plane), box.center) + plane.w;
+            const float r = glm::dot(glm::abs(glm::vec3(plane)), box.halfSize);
+
+            if (s + r < 0.0f) {
+                return Containment::OUTSIDE;
+            }
+            if (s - r >= 0.0f) {
+                planeMask &= ~bit;
+            }
+        }
+        return planeMask ? Containment::INTERSECTS : Containment::INSIDE;
+    }
+
+    bool isAABBInsideFrustum(const AABB& box, uint8_t planeMask) const {
+        return classifyAABB(box, planeMask) != Containment::OUTSIDE;
+    }
+
     glm::vec3 intersectPlanes(FrustumPlane A,  FrustumPlane B, FrustumPlane C) const {
         const glm::vec4 p1 = planes[static_cast<int>(A)];
         const glm::vec4 p2 = planes[static_cast<int>(B)];
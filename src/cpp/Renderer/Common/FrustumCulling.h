@@ -0,0 +1,235 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory/soa_vector.h>
+#include "Frustum.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE 1
+#endif
+
+/* AABBs split into one array per component, the layout the batched frustum tests read */
+struct AABBStreams {
+    const float* centerX = nullptr;
+    const float* centerY = nullptr;
+    const float* centerZ = nullptr;
+    const float* halfX = nullptr;
+    const float* halfY = nullptr;
+    const float* halfZ = nullptr;
+    size_t count = 0;
+
+    AABB at(const size_t index) const {
+        return {
+            {centerX[index], centerY[index], centerZ[index]},
+            {halfX[index], halfY[index], halfZ[index]}
+        };
+    }
+};
+
+/* owning SoA storage for AABBStreams, every component column is 64 byte aligned */
+class CullBounds {
+    enum Column { CENTER_X, CENTER_Y, CENTER_Z, HALF_X, HALF_Y, HALF_Z };
+
+    mem::soa_vector<> columns{
+        mem::type_info_of<float>, mem::type_info_of<float>, mem::type_info_of<float>,
+        mem::type_info_of<float>, mem::type_info_of<float>, mem::type_info_of<float>
+    };
+
+    const float* column(const Column col) const {
+        return columns.column<float>(col).begin();
+    }
+public:
+    uint32_t add(const AABB& box) {
+        return static_cast<uint32_t>(columns.emplace_row(
+            box.center.x, box.center.y, box.center.z,
+            box.halfSize.x, box.halfSize.y, box.halfSize.z
+        ));
+    }
+
+    void set(const uint32_t index, const AABB& box) {
+        columns.column<float>(CENTER_X)[index] = box.center.x;
+        columns.column<float>(CENTER_Y)[index] = box.center.y;
+        columns.column<float>(CENTER_Z)[index] = box.center.z;
+        columns.column<float>(HALF_X)[index] = box.halfSize.x;
+        columns.column<float>(HALF_Y)[index] = box.halfSize.y;
+        columns.column<float>(HALF_Z)[index] = box.halfSize.z;
+    }
+
+    /* the last box takes the removed index */
+    void swapRemove(const uint32_t index) {
+        columns.swap_remove(index);
+    }
+
+    void reserve(const size_t count) {
+        columns.reserve(count);
+    }
+
+    void clear() {
+        columns.clear();
+    }
+
+    size_t size() const {
+        return columns.size();
+    }
+
+    AABBStreams streams() const {
+        return {
+            column(CENTER_X), column(CENTER_Y), column(CENTER_Z),
+            column(HALF_X), column(HALF_Y), column(HALF_Z),
+            columns.size()
+        };
+    }
+};
+
+/**
+ * Batched AABB vs frustum tests, 8 boxes per step with AVX or two SSE lanes of 4.
+ * A box is rejected when its positive vertex is behind any tested plane, the same test as
+ * Frustum::isAABBInsideFrustum. planeMask selects the planes to test, bit i is Frustum::planes[i]
+ */
+namespace FrustumCulling {
+    constexpr static uint8_t ALL_PLANES = Frustum::ALL_PLANES;
+    constexpr static size_t BATCH = 8;
+
+    struct CullPlane {
+        float nx, ny, nz, w;
+        float ax, ay, az;
+    };
+
+    struct CullPlanes {
+        CullPlane planes[6]{};
+        int count = 0;
+
+        CullPlanes(const Frustum& frustum, const uint8_t planeMask) {
+            for (int i = 0; i < 6; ++i) {
+                if (!(planeMask & (1u << i))) continue;
+
+                const glm::vec4& p = frustum.planes[i];
+                planes[count++] = {p.x, p.y, p.z, p.w, std::abs(p.x), std::abs(p.y), std::abs(p.z)};
+            }
+        }
+    };
+
+    inline bool isVisible(const CullPlanes& planes, const AABBStreams& bounds, const size_t i) {
+        for (int p = 0; p < planes.count; ++p) {
+            const CullPlane& plane = planes.planes[p];
+
+            const float s = plane.nx * bounds.centerX[i] + plane.ny * bounds.centerY[i] + plane.nz * bounds.centerZ[i] + plane.w;
+            const float r = plane.ax * bounds.halfX[i] + plane.ay * bounds.halfY[i] + plane.az * bounds.halfZ[i];
+
+            if (s + r < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* bit j of the result is set when box first + j is visible, first must leave a full batch */
+    inline uint32_t testBatch(const CullPlanes& planes, const AABBStreams& bounds, const size_t first) {
+#if defined(FRUSTUM_CULLING_AVX)
+        const __m256 cx = _mm256_loadu_ps(bounds.centerX + first);
+        const __m256 cy = _mm256_loadu_ps(bounds.centerY + first);
+        const __m256 cz = _mm256_loadu_ps(bounds.centerZ + first);
+        const __m256 hx = _mm256_loadu_ps(bounds.halfX + first);
+        const __m256 hy = _mm256_loadu_ps(bounds.halfY + first);
+        const __m256 hz = _mm256_loadu_ps(bounds.halfZ + first);
+
+        __m256 outside = _mm256_setzero_ps();
+
+        for (int p = 0; p < planes.count; ++p) {
+            const CullPlane& plane = planes.planes[p];
+
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.nx), cx), _mm256_set1_ps(plane.w));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.ny), cy));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.nz), cz));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.ax), hx));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.ay), hy));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.az), hz));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        return ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+#elif defined(FRUSTUM_CULLING_SSE)
+        uint32_t visible = 0;
+
+        for (size_t half = 0; half < BATCH; half += 4) {
+            const size_t at = first + half;
+
+            const __m128 cx = _mm_loadu_ps(bounds.centerX + at);
+            const __m128 cy = _mm_loadu_ps(bounds.centerY + at);
+            const __m128 cz = _mm_loadu_ps(bounds.centerZ + at);
+            const __m128 hx = _mm_loadu_ps(bounds.halfX + at);
+            const __m128 hy = _mm_loadu_ps(bounds.halfY + at);
+            const __m128 hz = _mm_loadu_ps(bounds.halfZ + at);
+
+            __m128 outside = _mm_setzero_ps();
+
+            for (int p = 0; p < planes.count; ++p) {
+                const CullPlane& plane = planes.planes[p];
+
+                __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.nx), cx), _mm_set1_ps(plane.w));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.ny), cy));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.nz), cz));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.ax), hx));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.ay), hy));
+                d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.az), hz));
+
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+            }
+            visible |= (~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu) << half;
+        }
+        return visible;
+#else
+        uint32_t visible = 0;
+        for (size_t j = 0; j < BATCH; ++j) {
+            visible |= static_cast<uint32_t>(isVisible(planes, bounds, first + j)) << j;
+        }
+        return visible;
+#endif
+    }
+
+    /* calls fn(first, visibleBits) per batch, the trailing partial batch is tested scalar */
+    template <typename Fn>
+    void forEachBatch(const Frustum& frustum, const AABBStreams& bounds, const uint8_t planeMask, Fn&& fn) {
+        const CullPlanes planes(frustum, planeMask);
+        const size_t full = bounds.count - bounds.count % BATCH;
+
+        for (size_t first = 0; first < full; first += BATCH) {
+            fn(first, testBatch(planes, bounds, first));
+        }
+
+        if (full != bounds.count) {
+            uint32_t visible = 0;
+            for (size_t i = full; i < bounds.count; ++i) {
+                visible |= static_cast<uint32_t>(isVisible(planes, bounds, i)) << (i - full);
+            }
+            fn(full, visible);
+        }
+    }
+
+    /* writes the indices of visible boxes to visible, which needs room for bounds.count entries, returns how many */
+    inline uint32_t cull(const Frustum& frustum, const AABBStreams& bounds, uint32_t* visible, const uint8_t planeMask = ALL_PLANES) {
+        uint32_t count = 0;
+
+        forEachBatch(frustum, bounds, planeMask, [&](const size_t first, uint32_t bits) {
+            while (bits) {
+                visible[count++] = static_cast<uint32_t>(first) + std::countr_zero(bits);
+                bits &= bits - 1;
+            }
+        });
+        return count;
+    }
+
+    /* bit i of visibleBits is set when box i is visible, visibleBits needs (bounds.count + 63) / 64 words */
+    inline void cullMask(const Frustum& frustum, const AABBStreams& bounds, uint64_t* visibleBits, const uint8_t planeMask = ALL_PLANES) {
+        std::memset(visibleBits, 0, (bounds.count + 63) / 64 * sizeof(uint64_t));
+
+        forEachBatch(frustum, bounds, planeMask, [&](const size_t first, const uint32_t bits) {
+            visibleBits[first / 64] |= static_cast<uint64_t>(bits) << (first % 64);
+        });
+    }
+}
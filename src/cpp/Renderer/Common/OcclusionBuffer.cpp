@@ -0,0 +1,275 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <constexpr/assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_BUFFER_SSE 1
+#endif
+
+namespace {
+    /* E(x, y) = a * x + b * y + c, positive left of p -> q */
+    struct EdgeFunction {
+        float a, b, c;
+
+        EdgeFunction(const glm::vec3& p, const glm::vec3& q) : a(p.y - q.y), b(q.x - p.x), c(p.x * q.y - p.y * q.x) {}
+    };
+}
+
+OcclusionBuffer::OcclusionBuffer(const int width, const int height) : width(width), height(height) {
+    cexpr::require(width > 0 && height > 0 && width % 4 == 0);
+
+    glm::ivec2 size(width, height);
+
+    while (true) {
+        levelSizes.push_back(size);
+        levels.emplace_back(static_cast<size_t>(size.x) * size.y, 1.0f);
+
+        if (size.x == 1 && size.y == 1) {
+            break;
+        }
+        size = glm::max((size + 1) / 2, glm::ivec2(1));
+    }
+}
+
+void OcclusionBuffer::begin(const glm::mat4& viewProjection) {
+    this->viewProjection = viewProjection;
+    std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+    built = false;
+}
+
+void OcclusionBuffer::addOccluder(const glm::mat4& model, const std::span<const glm::vec3> vertices, const std::span<const uint32_t> indices) {
+    cexpr::require(!built);
+
+    const glm::mat4 mvp = viewProjection * model;
+
+    clipVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        clipVertices[i] = mvp * glm::vec4(vertices[i], 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        rasterizeTriangle(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]]);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    const glm::vec4 in[3] = {a, b, c};
+
+    // clip against the near plane z >= -w, a triangle becomes at most a quad
+    glm::vec4 polygon[4];
+    int count = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& current = in[i];
+        const glm::vec4& next = in[(i + 1) % 3];
+
+        const float dCurrent = current.z + current.w;
+        const float dNext = next.z + next.w;
+
+        if (dCurrent >= 0.0f) {
+            polygon[count++] = current;
+        }
+        if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+            polygon[count++] = glm::mix(current, next, dCurrent / (dCurrent - dNext));
+        }
+    }
+
+    if (count < 3) {
+        return;
+    }
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; ++i) {
+        const glm::vec3 ndc = glm::vec3(polygon[i]) / polygon[i].w;
+
+        screen[i] = {
+            (ndc.x * 0.5f + 0.5f) * static_cast<float>(width),
+            (ndc.y * 0.5f + 0.5f) * static_cast<float>(height),
+            ndc.z * 0.5f + 0.5f
+        };
+    }
+
+    for (int i = 1; i + 1 < count; ++i) {
+        rasterizeScreenTriangle(screen[0], screen[i], screen[i + 1]);
+    }
+}
+
+void OcclusionBuffer::rasterizeScreenTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+
+    if (std::abs(area) < 1e-8f) {
+        return;
+    }
+
+    // occluders are two sided, wind every triangle counter clockwise
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    const int minX = std::max(0, static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x})))) & ~3;
+    const int maxX = std::min(width - 1, static_cast<int>(std::floor(std::max({v0.x, v1.x, v2.x}))));
+    const int minY = std::max(0, static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+    const int maxY = std::min(height - 1, static_cast<int>(std::floor(std::max({v0.y, v1.y, v2.y}))));
+
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+
+    const EdgeFunction e0(v1, v2);
+    const EdgeFunction e1(v2, v0);
+    const EdgeFunction e2(v0, v1);
+
+    // depth is affine in screen space, z = zA * x + zB * y + zC
+    const float invArea = 1.0f / area;
+    const float zA = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) * invArea;
+    const float zB = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) * invArea;
+    const float zC = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) * invArea;
+
+    float* depth = levels[0].data();
+
+#if defined(OCCLUSION_BUFFER_SSE)
+    const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    const __m128 a0 = _mm_set1_ps(e0.a), a1 = _mm_set1_ps(e1.a), a2 = _mm_set1_ps(e2.a);
+    const __m128 za = _mm_set1_ps(zA);
+
+    for (int y = minY; y <= maxY; ++y) {
+        const float py = static_cast<float>(y) + 0.5f;
+
+        const __m128 row0 = _mm_set1_ps(e0.b * py + e0.c);
+        const __m128 row1 = _mm_set1_ps(e1.b * py + e1.c);
+        const __m128 row2 = _mm_set1_ps(e2.b * py + e2.c);
+        const __m128 rowZ = _mm_set1_ps(zB * py + zC);
+
+        float* line = depth + static_cast<size_t>(y) * width;
+
+        for (int x = minX; x <= maxX; x += 4) {
+            const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixelOffsets);
+
+            const __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+            const __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+            const __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+
+            const __m128 inside = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+
+            if (!_mm_movemask_ps(inside)) {
+                continue;
+            }
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(za, px), rowZ);
+            const __m128 old = _mm_loadu_ps(line + x);
+            const __m128 nearest = _mm_min_ps(old, z);
+
+            _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; ++y) {
+        const float py = static_cast<float>(y) + 0.5f;
+        float* line = depth + static_cast<size_t>(y) * width;
+
+        for (int x = minX; x <= maxX; ++x) {
+            const float px = static_cast<float>(x) + 0.5f;
+
+            if (e0.a * px + e0.b * py + e0.c < 0.0f ||
+                e1.a * px + e1.b * py + e1.c < 0.0f ||
+                e2.a * px + e2.b * py + e2.c < 0.0f) {
+                continue;
+            }
+            line[x] = std::min(line[x], zA * px + zB * py + zC);
+        }
+    }
+#endif
+}
+
+void OcclusionBuffer::finish() {
+    for (size_t level = 1; level < levels.size(); ++level) {
+        const auto& src = levels[level - 1];
+        auto& dst = levels[level];
+
+        const glm::ivec2 srcSize = levelSizes[level - 1];
+        const glm::ivec2 dstSize = levelSizes[level];
+
+        for (int y = 0; y < dstSize.y; ++y) {
+            const int sy0 = y * 2;
+            const int sy1 = std::min(sy0 + 1, srcSize.y - 1);
+
+            for (int x = 0; x < dstSize.x; ++x) {
+                const int sx0 = x * 2;
+                const int sx1 = std::min(sx0 + 1, srcSize.x - 1);
+
+                dst[y * dstSize.x + x] = std::max(
+                    std::max(src[sy0 * srcSize.x + sx0], src[sy0 * srcSize.x + sx1]),
+                    std::max(src[sy1 * srcSize.x + sx0], src[sy1 * srcSize.x + sx1])
+                );
+            }
+        }
+    }
+    built = true;
+}
+
+bool OcclusionBuffer::isVisible(const AABB& box) const {
+    cexpr::require(built);
+
+    const glm::vec3 min = box.min();
+    const glm::vec3 max = box.max();
+
+    glm::vec2 screenMin(std::numeric_limits<float>::max());
+    glm::vec2 screenMax(std::numeric_limits<float>::lowest());
+    float nearestDepth = std::numeric_limits<float>::max();
+
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 point(
+            corner & 1 ? max.x : min.x,
+            corner & 2 ? max.y : min.y,
+            corner & 4 ? max.z : min.z
+        );
+        const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+
+        if (clip.z < -clip.w || clip.w <= 0.0f) {
+            return true;
+        }
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        const glm::vec2 screen(
+            (ndc.x * 0.5f + 0.5f) * static_cast<float>(width),
+            (ndc.y * 0.5f + 0.5f) * static_cast<float>(height)
+        );
+
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+    }
+
+    const int x0 = std::max(0, static_cast<int>(std::floor(screenMin.x)));
+    const int y0 = std::max(0, static_cast<int>(std::floor(screenMin.y)));
+    const int x1 = std::min(width - 1, static_cast<int>(std::floor(screenMax.x)));
+    const int y1 = std::min(height - 1, static_cast<int>(std::floor(screenMax.y)));
+
+    // off screen, leave the decision to frustum culling
+    if (x0 > x1 || y0 > y1) {
+        return true;
+    }
+
+    // the level where the box spans at most 3x3 texels
+    const auto span = static_cast<unsigned>(std::max(x1 - x0, y1 - y0) + 1);
+    const int level = std::min(std::max(static_cast<int>(std::bit_width(span - 1)) - 1, 0), static_cast<int>(levels.size()) - 1);
+
+    const auto& depth = levels[level];
+    const int levelWidth = levelSizes[level].x;
+
+    for (int y = y0 >> level; y <= y1 >> level; ++y) {
+        for (int x = x0 >> level; x <= x1 >> level; ++x) {
+            if (depth[y * levelWidth + x] >= nearestDepth) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Math/Shapes/AABB.h>
+#include "RendererAPI.h"
+
+/**
+ * Low resolution CPU depth buffer for occlusion culling.
+ * A few large occluders are rasterized 4 pixels at a time, then a max depth pyramid is built
+ * so a box is tested against at most 3x3 texels whatever its size on screen.
+ * Depth is z / w remapped to [0, 1], 1 is the far plane
+ *
+ * begin(viewProjection) -> addOccluder... -> finish() -> isVisible...
+ */
+class RENDERERAPI OcclusionBuffer {
+    int width = 0;
+    int height = 0;
+
+    glm::mat4 viewProjection{1.0f};
+
+    /* levels[0] is the rasterized depth, texels of level i + 1 hold the farthest depth of 2x2 texels of level i */
+    std::vector<std::vector<float>> levels{};
+    std::vector<glm::ivec2> levelSizes{};
+    bool built = false;
+
+    std::vector<glm::vec4> clipVertices{};
+
+    void rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+    /* vertices in pixels, z is depth */
+    void rasterizeScreenTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+public:
+    /* width must be a multiple of 4 */
+    explicit OcclusionBuffer(int width = 256, int height = 128);
+
+    void begin(const glm::mat4& viewProjection);
+
+    /* indices is a triangle list, occluders should be closed and lie inside the geometry they stand for */
+    void addOccluder(const glm::mat4& model, std::span<const glm::vec3> vertices, std::span<const uint32_t> indices);
+
+    void finish();
+
+    /* false only when box is certainly behind the occluders, boxes crossing the near plane are always visible */
+    bool isVisible(const AABB& box) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    const float* getDepth() const { return levels[0].data(); }
+};
@@ -11,6 +11,16 @@ class Frame {
     };
     Renderer* renderer{};
     std::vector<std::pair<void*, PassInvocation>> invocations{};
+    /* lists handed out by createVisibleList, [0, numFinalizedLists) are already finalized */
+    mutable std::vector<VisiblePrimitiveList*> visibleLists{};
+    mutable size_t numFinalizedLists = 0;
+
+    /* passes only read their lists, whatever was drawn into them is grouped by type before the next pass runs */
+    void finalizeVisibleLists() const {
+        for (; numFinalizedLists < visibleLists.size(); ++numFinalizedLists) {
+            visibleLists[numFinalizedLists]->finalize();
+        }
+    }
 public:
     explicit Frame(Renderer* renderer) : renderer(renderer) {}
 
@@ -31,6 +41,7 @@ public:
     void render() {
         unsigned id = 0;
         for (auto& [invData, invLogic] : invocations) {
+            finalizeVisibleLists();
             invLogic.onExecute(invData, this, PassInvocationID{id});
             ++id;
         }
@@ -42,10 +53,28 @@ public:
         return renderer->getRenderAllocator();
     }
 
+    /* the list is finalized by render() before the first pass that runs after it was created */
     VisiblePrimitiveList* createVisibleList(PrimitiveWorld* world) const {
         auto mem = renderer->getRenderAllocator()->allocateAsTrivial<VisiblePrimitiveList>(1);
 
-        new (mem) VisiblePrimitiveList(renderer, world);
+        new (mem) VisiblePrimitiveList(renderer->getRenderAllocator(), world);
+        visibleLists.push_back(mem);
         return mem;
     }
+
+    /* a list culled for one view of world through the cull cache the renderer keeps for that view */
+    VisiblePrimitiveList* cullVisibleList(PrimitiveWorld* world, const uint32_t view, const Frustum& frustum, const PassMask& passes, const OcclusionBuffer* occlusion = nullptr, LodSelector* lodSelector = nullptr) const {
+        auto* list = createVisibleList(world);
+
+        list->cull(frustum, passes, occlusion, lodSelector, &renderer->getCullCache(*world, view));
+        return list;
+    }
+
+    /* fills lists[i] with what frusta[i] sees of passes, every view is culled in the same world traversal */
+    void createVisibleLists(PrimitiveWorld* world, const Frustum* frusta, VisiblePrimitiveList** lists, const unsigned count, const PassMask& passes) const {
+        for (unsigned view = 0; view < count; ++view) {
+            lists[view] = createVisibleList(world);
+        }
+        VisiblePrimitiveList::cullViews(frusta, lists, count, passes);
+    }
 };
\ No newline at end of file
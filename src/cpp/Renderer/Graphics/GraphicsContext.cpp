@@ -6,6 +6,7 @@
 #include <Renderer/Resource/Geometry/GeometryQuery.h>
 #include <Renderer/Resource/Texture/RenderTexture.h>
 #include <Renderer/Resource/Texture/TextureQuery.h>
+#include <Renderer/Resource/Buffer/BufferComponentType.h>
 
 #include "GraphicsPass.h"
 #include <Renderer/Graphics/State/GlobalRenderState.h>
@@ -89,6 +90,13 @@ void GraphicsContext::setScissorState(ScissorState scissor) {
     OPENGL_STATE_APPLICATION.current.scissorState = scissor;
 }
 
+// overflow frame scratch is written on the CPU, its bytes reach the GL buffer right before they are bound
+static void UploadIfStaged(const BufferBlockData* block, const size_t offset, const size_t size) {
+    if (GPUBuffer* backing = block->backingBuffer; backing->staging) {
+        backing->ref->uploadStagedScratch(backing, block->offset + offset, size);
+    }
+}
+
 void GraphicsContext::bindBuffer(BufferTarget target, const BufferKey key, int bufferBindingIndex, size_t offset, size_t size) {
     auto& buffer = key.buffer;
 
@@ -97,6 +105,7 @@ void GraphicsContext::bindBuffer(BufferTarget target, const BufferKey key, int b
     if (target != BufferTarget::SHADER_STORAGE_BUFFER) {
         assert(false);
     }
+    UploadIfStaged(buffer, offset, size);
     assert(buffer->backingBuffer->gpuSSBO);
 
     if (size == 0) {
@@ -107,12 +116,14 @@ void GraphicsContext::bindBuffer(BufferTarget target, const BufferKey key, int b
 }
 
 void GraphicsContext::bindIndirectDrawBuffer(BufferKey key) {
+    UploadIfStaged(key.buffer, 0, key.buffer->size);
     if (drawIndirectBuffer == key) return;
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, key.buffer->backingBuffer->gpuSSBO);
     drawIndirectBuffer = key;
 }
 
 void GraphicsContext::bindIndirectComputeBuffer(BufferKey key) {
+    UploadIfStaged(key.buffer, 0, key.buffer->size);
     if (computeIndirectBuffer == key) return;
     glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, key.buffer->backingBuffer->gpuSSBO);
     computeIndirectBuffer = key;
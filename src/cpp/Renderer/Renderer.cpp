@@ -9,37 +9,26 @@
 #include "Resource/Buffer/BufferComponentType.h"
 #include "Resource/Geometry/GeometryBuilder.h"
 #include "Resource/Material/MaterialStorage.h"
-
-struct AllocationRecord {
-    mem::typeindex type;
-    size_t count;
-};
-
-static tbb::enumerable_thread_specific<std::vector<AllocationRecord>> records;
+#include "Scene/Primitives/PrimitiveWorld.h"
+#include <map>
 
 void * FrameScopedGraphicsAllocator::allocate(mem::typeindex type, size_t count) {
-    void* mem = allocators.local().arena.allocate(type, count);
-    records.local().emplace_back(type, count);
-    return mem;
+    telemetry.record_allocation(type.size() * count);
+    return allocators.local().arena.allocate(type, count);
 }
 
 void FrameScopedGraphicsAllocator::reset() {
-    for (auto& alloc : allocators) {
-     //   std::cout << "Used: " << alloc.arena.bytes_used() << std::endl;
-     //   std::cout << "Alloc: " << alloc.arena.total_capacity() << std::endl;
-        alloc.arena.reset_compact();
+    if constexpr (mem::is_telemetry_enabled) {
+        mem::allocator_usage usage;
+        for (auto& alloc : allocators) {
+            usage += alloc.arena.usage();
+        }
+        telemetry.end_frame(usage);
     }
-    size_t total = 0;
-
-    for (auto& rcds : records) {
 
-        for (auto& record : rcds) {
-        //    std::cout << "Allocation : " << record.type.name << ": " << record.count << ", Bytes: " << record.type.size * record.count << std::endl;
-            total += record.type.size() * record.count;
-        }
-        rcds.clear();
+    for (auto& alloc : allocators) {
+        alloc.arena.reset_presized(alloc.highWater.sample(alloc.arena.bytes_used()));
     }
-  //  std::cout << "Total: " << total << std::endl;
 }
 
 struct Renderer::Impl {
@@ -49,6 +38,7 @@ struct Renderer::Impl {
     TextureResourceType textureStorage;
     MaterialStorage materialResource;
 
+    std::map<std::pair<const PrimitiveWorld*, uint32_t>, WorldCullCache> cullCaches;
 
     ShaderKey fullScreenShader;
     GeometryKey fullScreenQuad;
@@ -107,6 +97,21 @@ void Renderer::endFrame() {
     impl->materialResource.onFrameFinished(*this);
 }
 
+WorldCullCache& Renderer::getCullCache(PrimitiveWorld& world, const uint32_t view) {
+    auto [it, inserted] = impl->cullCaches.try_emplace({&world, view});
+
+    if (inserted) {
+        it->second = world.createCullCache();
+    }
+    return it->second;
+}
+
+void Renderer::releaseCullCaches(const PrimitiveWorld& world) {
+    std::erase_if(impl->cullCaches, [&](const auto& entry) {
+        return entry.first.first == &world;
+    });
+}
+
 void Renderer::render(const RenderPass &renderPass) {
     GraphicsContext ctx(this);
 
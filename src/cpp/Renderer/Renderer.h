@@ -19,24 +19,29 @@ struct RenderTexture;
 class RenderPass;
 class RenderInvocation;
 struct CameraComponent;
+class PrimitiveWorld;
+class WorldCullCache;
 
 class FrameScopedGraphicsAllocator : public GraphicsAllocator {
     struct LocalArena {
         mem::byte_arena<mem::same_alloc_schema, 64> arena;
-
-        struct AllocationTrack {
-        };
+        mem::high_water_mark highWater;
 
         LocalArena() = default;
-        LocalArena(size_t capacity) : arena(capacity) {}
+        LocalArena(size_t capacity) : arena(capacity), highWater(capacity) {}
     };
     tbb::enumerable_thread_specific<LocalArena> allocators;
+    MEM_NO_UNIQUE_ADDRESS mem::allocator_telemetry telemetry{"FrameScopedGraphicsAllocator"};
 public:
     FrameScopedGraphicsAllocator() : allocators(0.01 * 1024 * 1024) {}
 
     void* allocate(mem::typeindex type, size_t count) override;
 
     void reset();
+
+    mem::allocator_stats stats() const {
+        return telemetry.stats();
+    }
 };
 
 class RENDERERAPI Renderer {
@@ -92,6 +97,15 @@ public:
         return level.getSystem<T>();
     }
 
+    /**
+     * The cull cache of one view of world, created on first use and kept across frames.
+     * view is any id the caller keeps stable for the camera, e.g. its entity
+     */
+    WorldCullCache& getCullCache(PrimitiveWorld& world, uint32_t view);
+
+    /* drops every cull cache of world, call before the world goes away */
+    void releaseCullCaches(const PrimitiveWorld& world);
+
     const ShaderProgram* getShaderProgram(ShaderKey shader) const;
 
     ShaderComponentType& getShaderStorage();
@@ -52,6 +52,10 @@ GLbitfield ToGLMapFlags(BufferUsageHint usage) {
 AMappedBufferRange BufferBlockData::createStagingBufferForRange(size_t byteOffset, size_t byteSize) {
     clamp(byteOffset, byteSize);
 
+    if (backingBuffer->staging) { // overflow scratch, uploaded when bound
+        return AMappedBufferRange(backingBuffer->staging + offset + byteOffset, byteSize);
+    }
+
     if (backingBuffer->usage == BufferUsageHint::IMMUTABLE) {
         return backingBuffer->ref->createStagingRegion(this, byteOffset, byteSize);
     }
@@ -95,13 +99,106 @@ void CreateSSBO(GPUBuffer* buffer, AMappedBufferRange initialData) {
     }
 }
 
-void BufferResourceStorage::initialize() {
-    for (auto& frameBuffer : frameBuffers) {
-        frameBuffer.descriptor.sizeBytes = 4 * 1024 * 1024;
-        frameBuffer.usage = BufferUsageHint::FRAME_SCRATCH_BUFFER;
-        frameBuffer.ref = this;
+void DestroySSBO(GPUBuffer* buffer) {
+    if (buffer->mapped) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer->gpuSSBO);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    }
+    glDeleteBuffers(1, &buffer->gpuSSBO);
+
+    buffer->gpuSSBO = 0;
+    buffer->mapped = nullptr;
+}
+
+// keeps the buffer unless it is too small or more than twice the size it needs to be
+void ResizeFrameScratch(GPUBuffer* buffer, size_t bytes) {
+    const size_t capacity = buffer->descriptor.sizeBytes;
+
+    if (buffer->gpuSSBO && capacity >= bytes && capacity <= bytes * 2) {
+        return;
+    }
+    if (buffer->gpuSSBO) {
+        DestroySSBO(buffer);
+    }
+    buffer->descriptor.sizeBytes = bytes;
+    CreateSSBO(buffer, {});
+}
+
+bool BufferResourceStorage::FrameScratchBlock::tryBump(size_t bytes, size_t& offset) {
+    size_t old = next.load(std::memory_order_relaxed);
+
+    do {
+        if (old + bytes > buffer.descriptor.sizeBytes) {
+            return false;
+        }
+    } while (!next.compare_exchange_weak(old, old + bytes, std::memory_order_relaxed));
+
+    offset = old;
+    return true;
+}
+
+BufferResourceStorage::FrameScratchBlock* BufferResourceStorage::overflowFrameScratch(FrameScratchChain& chain, FrameScratchBlock* full, const size_t bytes) {
+    FrameScratchBlock* successor = full->successor.load(std::memory_order_acquire);
+    if (successor) {
+        return successor;
+    }
+
+    const size_t capacity = std::max(bytes, full->buffer.descriptor.sizeBytes * 2);
 
-        CreateSSBO(&frameBuffer, {});
+    auto* created = new (chain.overflowMemory.allocate(sizeof(FrameScratchBlock), alignof(FrameScratchBlock))) FrameScratchBlock();
+    created->buffer.staging = static_cast<char*>(chain.overflowMemory.allocate(capacity, 64));
+    created->buffer.usage = BufferUsageHint::FRAME_SCRATCH_BUFFER;
+    created->buffer.ref = this;
+    created->buffer.descriptor.sizeBytes = capacity;
+
+    if (full->successor.compare_exchange_strong(successor, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return created;
+    }
+    // another thread installed one first, the arena gets the memory back on recycle
+    created->~FrameScratchBlock();
+    return successor;
+}
+
+void BufferResourceStorage::recycleFrameScratch(FrameScratchChain& chain) {
+    size_t used = 0;
+    for (FrameScratchBlock* block = &chain.primary; block; block = block->successor.load(std::memory_order_relaxed)) {
+        used += block->next.load(std::memory_order_relaxed);
+    }
+
+    // the GL driver keeps replaced buffers alive until in-flight frames stop referencing them
+    ResizeFrameScratch(&chain.primary.buffer, chain.highWater.sample(used));
+
+    for (FrameScratchBlock* block = chain.primary.successor.load(std::memory_order_relaxed); block;) {
+        FrameScratchBlock* next = block->successor.load(std::memory_order_relaxed);
+
+        // blocks that were never bound never got a GL buffer
+        if (block->buffer.gpuSSBO) {
+            DestroySSBO(&block->buffer);
+        }
+        block->~FrameScratchBlock();
+        block = next;
+    }
+    // a spike grew the chain, the next frames start from a single small block again
+    chain.overflowMemory.reset_presized(FrameScratchChain::OVERFLOW_MEMORY_BYTES);
+
+    chain.primary.next.store(0, std::memory_order_relaxed);
+    chain.primary.successor.store(nullptr, std::memory_order_relaxed);
+    chain.current.store(&chain.primary, std::memory_order_release);
+}
+
+void BufferResourceStorage::uploadStagedScratch(GPUBuffer* buffer, const size_t offset, const size_t bytes) {
+    if (!buffer->gpuSSBO) {
+        CreateSSBO(buffer, {});
+    }
+    // the mapping is coherent, the copy is visible to every command issued after it
+    std::memcpy(buffer->mapped + offset, buffer->staging + offset, bytes);
+}
+
+void BufferResourceStorage::initialize() {
+    for (auto& chain : frameScratch) {
+        chain.primary.buffer.usage = BufferUsageHint::FRAME_SCRATCH_BUFFER;
+        chain.primary.buffer.ref = this;
+        recycleFrameScratch(chain);
     }
 }
 
@@ -182,16 +279,12 @@ void BufferResourceStorage::onFrameFinished() {
     debugFrameBuffer.clear();
 
     for (auto& queue : destructionQueue[clearDestructionIdx]) {
-        if (queue->mapped) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue->gpuSSBO);
-            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-        }
-        glDeleteBuffers(1, &queue->gpuSSBO);
+        DestroySSBO(queue);
         std::memset(queue, 0, sizeof(GPUBuffer));
         freeGpuBuffers.push(queue);
     }
 
-    frameBufferNext[currentFrame] = 0;
+    recycleFrameScratch(frameScratch[currentFrame]);
 
     currentFrame = (currentFrame + 1) % 3;
 
@@ -219,17 +312,26 @@ GPUBuffer * BufferResourceStorage::createGPUBuffer(size_t bytes, BufferUsageHint
 std::pair<BufferBlockData *, AMappedBufferRange> BufferResourceStorage::createFrameBlock(size_t bytes) {
     const uint32_t totalBytes = bytes + DEBUG_EXTRA_BYTES;
 
-    size_t offset = frameBufferNext[currentFrame].fetch_add(totalBytes, std::memory_order_relaxed);
+    auto& chain = frameScratch[currentFrame];
+    FrameScratchBlock* scratch = chain.current.load(std::memory_order_acquire);
+    size_t offset = 0;
 
-    assert(offset + totalBytes <= frameBuffers[currentFrame].descriptor.sizeBytes);
+    while (!scratch->tryBump(totalBytes, offset)) {
+        FrameScratchBlock* successor = overflowFrameScratch(chain, scratch, totalBytes);
 
-    char* ptr = frameBuffers[currentFrame].mapped + offset;
+        // on failure another thread already moved the chain on, continue from there
+        FrameScratchBlock* expected = scratch;
+        scratch = chain.current.compare_exchange_strong(expected, successor, std::memory_order_acq_rel) ? successor : expected;
+    }
 
-    std::memset(ptr + bytes, 55, DEBUG_EXTRA_BYTES);
+    char* ptr = (scratch->buffer.staging ? scratch->buffer.staging : scratch->buffer.mapped) + offset;
 
-    GPUBuffer* buffer = &frameBuffers[currentFrame];
+    GPUBuffer* buffer = &scratch->buffer;
 
-    debugFrameBuffer.emplace_back(std::stacktrace::current(), ptr + bytes);
+    if (DEBUG_EXTRA_BYTES) {
+        std::memset(ptr + bytes, 55, DEBUG_EXTRA_BYTES);
+        debugFrameBuffer.emplace_back(std::stacktrace::current(), ptr + bytes);
+    }
 
     BufferBlockData block;
     block.size = bytes;
@@ -2,6 +2,7 @@
 #include "BufferKey.h"
 #include <memory/AtomicPopList.h>
 #include <memory/byte_arena.h>
+#include <memory/atomic_byte_arena.h>
 #include <oneapi/tbb/enumerable_thread_specific.h>
 
 #include "RendererAPI.h"
@@ -36,13 +37,14 @@ class BufferResourceStorage {
     struct ThreadLocalStagingAllocator {
         using Arena = mem::byte_arena<mem::same_alloc_schema, 32>;
         Arena stagingArena = Arena(0.064 * 1024 * 1024);
+        mem::high_water_mark highWater{static_cast<size_t>(0.064 * 1024 * 1024)};
 
         char* allocate(size_t bytes) {
             return (char*)stagingArena.allocate(bytes, 8);
         }
 
         void reset() {
-            stagingArena.reset();
+            stagingArena.reset_presized(highWater.sample(stagingArena.bytes_used()));
         }
     };
 
@@ -70,8 +72,38 @@ class BufferResourceStorage {
 
     tbb::concurrent_vector<BufferBlockData*> toDestroy{};
 
-    GPUBuffer frameBuffers[3]{};
-    std::atomic<size_t> frameBufferNext[3]{};
+    /**
+     * Persistently mapped scratch buffer, the GL objects are only (re)created on the GL thread,
+     * worker threads just bump next and CAS the chain forward when a block is full
+     */
+    struct FrameScratchBlock {
+        GPUBuffer buffer{};
+        std::atomic<size_t> next = 0;
+        std::atomic<FrameScratchBlock*> successor = nullptr;
+
+        bool tryBump(size_t bytes, size_t& offset);
+    };
+
+    /**
+     * primary is sized to the frame's high-water mark. A spike past it chains overflow blocks of at least twice
+     * the previous size, written through staging in overflowMemory. The GL thread creates their GL buffers and
+     * uploads each range when it is bound, see uploadStagedScratch
+     */
+    struct FrameScratchChain {
+        constexpr static size_t OVERFLOW_MEMORY_BYTES = 256 * 1024;
+
+        FrameScratchBlock primary{};
+        std::atomic<FrameScratchBlock*> current = nullptr;
+        mem::high_water_mark highWater{4 * 1024 * 1024};
+        mem::chained_atomic_byte_arena overflowMemory{OVERFLOW_MEMORY_BYTES};
+    };
+
+    /* successor of full, installed with CAS if there is none yet, never fails */
+    FrameScratchBlock* overflowFrameScratch(FrameScratchChain& chain, FrameScratchBlock* full, size_t bytes);
+
+    void recycleFrameScratch(FrameScratchChain& chain);
+
+    FrameScratchChain frameScratch[3]{};
 
     tbb::concurrent_vector<std::pair<std::stacktrace, char*>> debugFrameBuffer{};
 
@@ -88,6 +120,9 @@ public:
     void synchronizeGpuBuffers();
     void onFrameFinished();
 
+    /* GL thread only, creates the GL buffer of staged scratch on first use and uploads [offset, offset + bytes) to it */
+    void uploadStagedScratch(GPUBuffer* buffer, size_t offset, size_t bytes);
+
     static size_t alignTo16(size_t bytes) {
         return (bytes + 15) & ~15;
     }
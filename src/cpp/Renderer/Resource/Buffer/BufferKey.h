@@ -26,6 +26,8 @@ struct GPUBuffer {
     BufferResourceStorage* ref{};
     BufferUsageHint usage{};
     char* mapped{};
+    /* CPU copy of frame scratch chained mid frame, written instead of mapped and uploaded when a range is bound */
+    char* staging{};
     std::atomic<int> uses = 1;
 };
 
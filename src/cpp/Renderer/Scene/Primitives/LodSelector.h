@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Renderer/Common/Frustum.h>
+#include "IPrimitive.h"
+#include "PrimitiveArray.h"
+
+/**
+ * Picks a detail level per visible primitive from its projected geometric error.
+ * The coarsest level whose error covers at most pixelError pixels wins. The last choice of every
+ * primitive is kept, and it only changes once the error leaves a band of +-hysteresis around the threshold,
+ * so objects near a switching distance do not pop every frame.
+ * One selector per view, levels chosen for a shadow cascade are unrelated to the camera's
+ */
+class LodSelector {
+public:
+    struct Settings {
+        float pixelError = 1.0f;
+        float hysteresis = 0.15f;
+        float viewportHeight = 1080.0f;
+    };
+private:
+    struct CollectionHistory {
+        unsigned gen = ~0u;
+        std::vector<uint8_t> levels;
+    };
+
+    Settings settings{};
+    std::vector<CollectionHistory> history{};
+
+    static constexpr uint8_t NO_LEVEL = 0xFF;
+public:
+    LodSelector() = default;
+    explicit LodSelector(const Settings& settings) : settings(settings) {}
+
+    Settings& getSettings() { return settings; }
+    const Settings& getSettings() const { return settings; }
+
+    /* pixels a world space length at view depth covers, orthographic projections ignore the depth */
+    static float pixelsPerUnit(const Frustum& frustum, const float viewportHeight, const float depth) {
+        const float scale = 0.5f * viewportHeight * frustum.projection[1][1];
+
+        if (frustum.projection[3][3] == 1.0f) {
+            return scale;
+        }
+        return scale / std::max(depth, 1e-4f);
+    }
+
+    /* coarsest level with errors[level] * pixelsPerUnit <= threshold, level 0 is always allowed */
+    static uint8_t select(const PrimitiveLods& lods, const float pixelsPerUnit, const float threshold) {
+        uint8_t level = 0;
+
+        while (level + 1 < lods.count && lods.errors[level + 1] * pixelsPerUnit <= threshold) {
+            ++level;
+        }
+        return level;
+    }
+
+    /* level for primitive of collection, pixelsPerUnit is taken at the primitive's nearest depth */
+    uint8_t choose(const PrimitiveCollectionID collection, const unsigned primitive, const unsigned primitiveCount, const PrimitiveLods& lods, const float pixelsPerUnit) {
+        if (lods.count < 2) {
+            return 0;
+        }
+
+        if (history.size() <= collection.id()) {
+            history.resize(collection.id() + 64);
+        }
+
+        auto& entry = history[collection.id()];
+        if (entry.gen != collection.gen()) {
+            entry.gen = collection.gen();
+            entry.levels.assign(primitiveCount, NO_LEVEL);
+        } else if (entry.levels.size() < primitiveCount) {
+            entry.levels.resize(primitiveCount, NO_LEVEL);
+        }
+
+        uint8_t& previous = entry.levels[primitive];
+
+        if (previous == NO_LEVEL || previous >= lods.count) {
+            previous = select(lods, pixelsPerUnit, settings.pixelError);
+            return previous;
+        }
+
+        // coarsen only well below the threshold, refine only well above it
+        const uint8_t coarsest = select(lods, pixelsPerUnit, settings.pixelError * (1.0f + settings.hysteresis));
+        const uint8_t finest = select(lods, pixelsPerUnit, settings.pixelError * (1.0f - settings.hysteresis));
+
+        previous = std::clamp(previous, finest, coarsest);
+        return previous;
+    }
+
+    /* drops the history, the next choice of every primitive is made without hysteresis */
+    void reset() {
+        history.clear();
+    }
+};
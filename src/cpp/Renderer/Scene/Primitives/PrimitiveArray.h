@@ -17,6 +17,11 @@ public:
         return mask.test(pass.id());
     }
 
+    /* true when both masks share a pass */
+    bool any(const PassMask& other) const {
+        return (mask & other.mask).any();
+    }
+
     PassMask& operator |= (const PassMask& other) {
         mask |= other.mask;
         return *this;
@@ -38,9 +43,29 @@ public:
     }
 };
 
+/**
+ * Ordered detail levels of a primitive, level 0 is the full geometry.
+ * errors[i] is the world space deviation of level i from level 0 and must not decrease with i.
+ * Zero levels means the primitive has a single geometry
+ */
+struct PrimitiveLods {
+    constexpr static int MAX_LEVELS = 6;
+
+    float errors[MAX_LEVELS]{};
+    uint8_t count = 0;
+
+    void add(const float error) {
+        assert(count < MAX_LEVELS && (!count || errors[count - 1] <= error));
+        errors[count++] = error;
+    }
+};
+
 struct Primitive {
     AABB localBounds{};
     PassMask passes{};
+    PrimitiveLods lods{};
+    /* material the pipeline draws the primitive with, visible lists order each collection type by it */
+    uint32_t material = 0;
 
     template <IsRenderingPass P>
     bool isInPass() const {
@@ -153,6 +178,8 @@ public:
 
     const AABB& getLocalBounds() const { return primitive->localBounds; }
     const PassMask& getPasses() const { return primitive->passes; }
+    const PrimitiveLods& getLods() const { return primitive->lods; }
+    uint32_t getMaterial() const { return primitive->material; }
 };
 
 template <typename P>
@@ -170,12 +197,19 @@ public:
     AABB& getLocalBounds() const { return primitive->localBounds; }
     PassMask& getPasses() const { return primitive->passes; }
 
+    PrimitiveLods& getLods() const { return primitive->lods; }
+    uint32_t getMaterial() const { return primitive->material; }
+
     AABB& setLocalBounds(const AABB& bounds) const { return primitive->localBounds = bounds; }
     PassMask& setPasses(const PassMask& passes) const { return primitive->passes = passes; }
+    PrimitiveLods& setLods(const PrimitiveLods& lods) const { return primitive->lods = lods; }
+    uint32_t setMaterial(const uint32_t material) const { return primitive->material = material; }
 
     PrimitiveReference& operator = (const Primitive& prim) {
         primitive->localBounds = prim.localBounds;
         primitive->passes = prim.passes;
+        primitive->lods = prim.lods;
+        primitive->material = prim.material;
         return *this;
     }
 
@@ -1,4 +1,7 @@
 #include "PrimitiveStorage.h"
+#include <Math/Shapes/geomBatch.h>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
 
 PrimitiveStorage::~PrimitiveStorage() {
     for (auto& collection : collections) {
@@ -95,3 +98,45 @@ void PrimitiveStorage::removeCollectionUnchecked(const PrimitiveCollectionID id)
     freeIndices.push_back(id.id());
     generations[id.id()]++;
 }
+
+void PrimitiveStorage::recomputeWorldBounds(const std::span<const PrimitiveCollectionID> ids) {
+    constexpr size_t GRAIN = 1024;
+
+    boundsLocal.resize(ids.size());
+    boundsTransforms.resize(ids.size());
+    boundsWorld.resize(ids.size());
+
+    const auto recompute = [&](const size_t first, const size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (const auto* collection = getCollection(ids[i])) {
+                boundsLocal[i] = collection->getLocalBounds();
+                boundsTransforms[i] = collection->getWorldTransform().createModel3D();
+            } else {
+                boundsLocal[i] = {};
+                boundsTransforms[i] = glm::mat4(1.0f);
+            }
+        }
+
+        geom::transformBounds(
+            std::span(boundsLocal).subspan(first, last - first),
+            std::span(boundsTransforms).subspan(first, last - first),
+            std::span(boundsWorld).subspan(first, last - first),
+            false
+        );
+
+        for (size_t i = first; i < last; ++i) {
+            if (auto* collection = getCollection(ids[i])) {
+                collection->worldBounds = boundsWorld[i];
+            }
+        }
+    };
+
+    if (ids.size() < 2 * GRAIN) {
+        recompute(0, ids.size());
+        return;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, ids.size(), GRAIN), [&](const tbb::blocked_range<size_t>& range) {
+        recompute(range.begin(), range.end());
+    });
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <memory/free_list_allocator.h>
+#include <span>
 
 #include "Primitive.h"
 #include "Renderer/Common/TypeAllocator.h"
@@ -13,6 +14,11 @@ class RENDERERAPI PrimitiveStorage {
     std::vector<unsigned> freeIndices{};
 
     mem::free_list_allocator primitivesAllocator;
+
+    /* scratch of recomputeWorldBounds */
+    std::vector<AABB> boundsLocal{};
+    std::vector<glm::mat4> boundsTransforms{};
+    std::vector<AABB> boundsWorld{};
 public:
     explicit PrimitiveStorage(const size_t capacity) : primitivesAllocator(0.064 * 1024 * 1024) {
         collections.reserve(capacity);
@@ -100,6 +106,12 @@ public:
 
     void removeCollectionUnchecked(PrimitiveCollectionID id);
 
+    /**
+     * recomputeWorldBounds of every valid collection of ids in one batch, matrices are built and boxes
+     * transformed on the TBB pool for large batches. ids must not repeat
+     */
+    void recomputeWorldBounds(std::span<const PrimitiveCollectionID> ids);
+
     void removeCollection(const PrimitiveCollectionID id) {
         if (isCollectionValid(id)) {
             removeCollectionUnchecked(id);
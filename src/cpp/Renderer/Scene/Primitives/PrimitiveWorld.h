@@ -2,19 +2,75 @@
 #include "PrimitiveStorage.h"
 #include "IPrimitive.h"
 #include "WorldCullCallback.h"
+#include <constexpr/assert.h>
+#include <utility>
 
 struct Frustum;
 
+/**
+ * Cull state one view keeps in a world between frames, from PrimitiveWorld::createCullCache.
+ * Empty for worlds without a cache, culling with it then is a plain cull
+ */
+class WorldCullCache {
+    friend class PrimitiveWorld;
+
+    const void* world{};
+    void* cache{};
+    void(*destroy)(void*){};
+public:
+    WorldCullCache() = default;
+    WorldCullCache(const void* world, void* cache, void(*destroy)(void*)) : world(world), cache(cache), destroy(destroy) {}
+
+    WorldCullCache(WorldCullCache&& other) noexcept
+    : world(std::exchange(other.world, nullptr)), cache(std::exchange(other.cache, nullptr)), destroy(std::exchange(other.destroy, nullptr)) {}
+
+    WorldCullCache& operator=(WorldCullCache&& other) noexcept {
+        if (this != &other) {
+            reset();
+            world = std::exchange(other.world, nullptr);
+            cache = std::exchange(other.cache, nullptr);
+            destroy = std::exchange(other.destroy, nullptr);
+        }
+        return *this;
+    }
+
+    WorldCullCache(const WorldCullCache&) = delete;
+    WorldCullCache& operator=(const WorldCullCache&) = delete;
+
+    ~WorldCullCache() {
+        reset();
+    }
+
+    void reset() {
+        if (cache) {
+            destroy(cache);
+        }
+        cache = nullptr;
+    }
+};
+
 struct WorldVTable {
     using OnCullFn = void(*)(void*, const Frustum& frustum, WorldCullCallback callback);
+    using OnCullViewsFn = void(*)(void*, const Frustum* frusta, unsigned count, WorldMultiCullCallback callback);
+    using OnRaycastFn = void(*)(void*, const Ray& ray, WorldRayCallback callback);
+    using OnOverlapFn = void(*)(void*, const AABB& box, WorldCullCallback callback);
     using OnAddCollectionFn = void(*)(void*, const PrimitiveCollectionID id, const PrimitiveCollection& collection);
     using OnRemoveCollectionFn = void(*)(void*, const PrimitiveCollectionID id, const PrimitiveCollection& collection);
     using OnUpdateCollectionFn = void(*)(void*, const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange& change);
+    using OnSynchronizeFn = void(*)(void*);
+    using OnCullCachedFn = void(*)(void*, const Frustum& frustum, WorldCullCallback callback, void* cache);
+    using CreateCullCacheFn = WorldCullCache(*)(void*);
 
     OnCullFn onCullFn{};
+    OnCullViewsFn onCullViewsFn{};
+    OnRaycastFn onRaycastFn{};
+    OnOverlapFn onOverlapFn{};
     OnAddCollectionFn onAddCollection{};
     OnRemoveCollectionFn onRemoveCollection{};
     OnUpdateCollectionFn onUpdateCollection{};
+    OnSynchronizeFn onSynchronize{};
+    OnCullCachedFn onCullCachedFn{};
+    CreateCullCacheFn createCullCache{};
 
     template <typename W>
     static WorldVTable of() {
@@ -23,6 +79,27 @@ struct WorldVTable {
         vt.onCullFn = [](void* ptr, const Frustum& frustum, WorldCullCallback callback) {
             static_cast<W*>(ptr)->onCull(frustum, callback);
         };
+        vt.onCullViewsFn = [](void* ptr, const Frustum* frusta, const unsigned count, WorldMultiCullCallback callback) {
+            if constexpr (requires(W& w) { w.onCullViews(frusta, count, callback); }) {
+                static_cast<W*>(ptr)->onCullViews(frusta, count, callback);
+            } else {
+                // worlds without a shared traversal cull once per view
+                for (unsigned view = 0; view < count; ++view) {
+                    auto perView = [&](const PrimitiveCollectionID collection) {
+                        callback(collection, 1u << view);
+                    };
+                    static_cast<W*>(ptr)->onCull(frusta[view], WorldCullCallback(&perView, [](const void* cb, PrimitiveCollectionID collection) {
+                        (*static_cast<const decltype(perView)*>(cb))(collection);
+                    }));
+                }
+            }
+        };
+        vt.onRaycastFn = [](void* ptr, const Ray& ray, WorldRayCallback callback) {
+            static_cast<W*>(ptr)->onRaycast(ray, callback);
+        };
+        vt.onOverlapFn = [](void* ptr, const AABB& box, WorldCullCallback callback) {
+            static_cast<W*>(ptr)->onOverlap(box, callback);
+        };
         vt.onAddCollection = [](void* ptr, const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
             static_cast<W*>(ptr)->onAddCollection(id, collection);
         };
@@ -32,6 +109,30 @@ struct WorldVTable {
         vt.onUpdateCollection = [](void* ptr, const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange &change) {
             static_cast<W*>(ptr)->onUpdateCollection(id, collection, change);
         };
+        vt.onSynchronize = [](void* ptr) {
+            // worlds that apply every change right away have nothing to sync
+            if constexpr (requires(W& w) { w.onSynchronize(); }) {
+                static_cast<W*>(ptr)->onSynchronize();
+            }
+        };
+        vt.onCullCachedFn = [](void* ptr, const Frustum& frustum, WorldCullCallback callback, void* cache) {
+            if constexpr (requires { typename W::CullCache; }) {
+                if (cache) {
+                    static_cast<W*>(ptr)->onCull(frustum, callback, *static_cast<typename W::CullCache*>(cache));
+                    return;
+                }
+            }
+            static_cast<W*>(ptr)->onCull(frustum, callback);
+        };
+        vt.createCullCache = [](void* ptr) {
+            if constexpr (requires { typename W::CullCache; }) {
+                return WorldCullCache(ptr, new typename W::CullCache(), [](void* cache) {
+                    delete static_cast<typename W::CullCache*>(cache);
+                });
+            } else {
+                return WorldCullCache(ptr, nullptr, nullptr);
+            }
+        };
         return vt;
     }
 };
@@ -39,6 +140,13 @@ struct WorldVTable {
 template <IsPrimitiveWorld T>
 class TPrimitiveWorld;
 
+struct WorldRayHit {
+    PrimitiveCollectionID collection{};
+    RayResult result{};
+
+    bool hasHit() const { return result.hasHit(); }
+};
+
 class PrimitiveWorld {
 protected:
     PrimitiveStorage* storage{};
@@ -88,6 +196,36 @@ public:
         }
     }
 
+    /**
+     * updateCollection for many collections at once with their flags kept. World bounds are recomputed in one
+     * batched pass, in parallel for large batches, before the world hears about any of them. ids must not repeat
+     */
+    void updateCollections(const std::span<const PrimitiveCollectionID> collections, const std::span<const Transform> newTransforms) {
+        cexpr::require(collections.size() == newTransforms.size());
+
+        std::vector<PrimitiveCollectionChange> changes;
+        changes.reserve(collections.size());
+
+        for (size_t i = 0; i < collections.size(); ++i) {
+            auto coll = storage->getCollection(collections[i]);
+
+            if (!coll) {
+                changes.emplace_back(Transform{}, PrimitiveCollectionFlags{}, false, false);
+                continue;
+            }
+            changes.emplace_back(coll->getWorldTransform(), coll->getFlags(), true, false);
+            coll->worldTransform = newTransforms[i];
+        }
+
+        storage->recomputeWorldBounds(collections);
+
+        for (size_t i = 0; i < collections.size(); ++i) {
+            if (changes[i].isTransformChanged()) {
+                worldVTable.onUpdateCollection(world, collections[i], *storage->getCollectionUnchecked(collections[i]), changes[i]);
+            }
+        }
+    }
+
     void removeCollection(const PrimitiveCollectionID collection) {
         if (const auto coll = storage->getCollection(collection)) {
             worldVTable.onRemoveCollection(world, collection, *coll);
@@ -105,6 +243,14 @@ public:
         return result ? result->is<C>() : nullptr;
     }
 
+    /**
+     * Applies the changes a world deferred, call once per frame after the collections were updated and before
+     * the first query. Queries may run concurrently with each other but never alongside this or any update
+     */
+    void synchronize() {
+        worldVTable.onSynchronize(world);
+    }
+
     template <typename Callback>
     void cull(const Frustum& frustum, Callback&& callback) {
         using TCallback = std::decay_t<Callback>;
@@ -114,6 +260,96 @@ public:
         worldVTable.onCullFn(world, frustum, cullCallback);
     }
 
+    /* a cache for one view of this world, hand the same one to every cull of that view */
+    WorldCullCache createCullCache() {
+        return worldVTable.createCullCache(world);
+    }
+
+    /* cull that reuses what cache remembers of the view's earlier culls where the world supports it */
+    template <typename Callback>
+    void cull(const Frustum& frustum, WorldCullCache& cache, Callback&& callback) {
+        cexpr::require(!cache.cache || cache.world == world);
+
+        using TCallback = std::decay_t<Callback>;
+        WorldCullCallback cullCallback(&callback, [](const void* cb, PrimitiveCollectionID collection) {
+            static_cast<const TCallback*>(cb)->operator()(collection);
+        });
+        worldVTable.onCullCachedFn(world, frustum, cullCallback, cache.cache);
+    }
+
+    /**
+     * Culls up to WorldMultiCullCallback::MAX_VIEWS frusta in one traversal,
+     * callback(PrimitiveCollectionID, uint32_t viewMask) runs once per collection any view sees
+     */
+    template <typename Callback>
+    void cullViews(const Frustum* frusta, const unsigned count, Callback&& callback) {
+        cexpr::require(count <= WorldMultiCullCallback::MAX_VIEWS);
+
+        using TCallback = std::decay_t<Callback>;
+        WorldMultiCullCallback cullCallback(&callback, [](const void* cb, PrimitiveCollectionID collection, uint32_t viewMask) {
+            static_cast<const TCallback*>(cb)->operator()(collection, viewMask);
+        });
+        worldVTable.onCullViewsFn(world, frusta, count, cullCallback);
+    }
+
+    /**
+     * callback(PrimitiveCollectionID, const RayResult&) -> float runs for every collection whose world bounds
+     * the ray hits, in no particular order, and returns the length the ray keeps going for, see WorldRayCallback.
+     * Collections with infinite bounds have no box to hit and are skipped
+     */
+    template <typename Callback>
+    void raycast(const Ray& ray, Callback&& callback) {
+        using TCallback = std::decay_t<Callback>;
+        WorldRayCallback rayCallback(&callback, [](const void* cb, PrimitiveCollectionID collection, const RayResult& hit) {
+            return static_cast<float>(static_cast<const TCallback*>(cb)->operator()(collection, hit));
+        });
+        worldVTable.onRaycastFn(world, ray, rayCallback);
+    }
+
+    /* raycast from `from` to `to` */
+    template <typename Callback>
+    void segment(const glm::vec3 from, const glm::vec3 to, Callback&& callback) {
+        if (from != to) {
+            raycast(Ray::cast(from, to), std::forward<Callback>(callback));
+        }
+    }
+
+    /* callback(PrimitiveCollectionID) for every collection whose world bounds overlap box */
+    template <typename Callback>
+    void overlap(const AABB& box, Callback&& callback) {
+        using TCallback = std::decay_t<Callback>;
+        WorldCullCallback overlapCallback(&callback, [](const void* cb, PrimitiveCollectionID collection) {
+            static_cast<const TCallback*>(cb)->operator()(collection);
+        });
+        worldVTable.onOverlapFn(world, box, overlapCallback);
+    }
+
+    /**
+     * Closest collection along ray. refine(PrimitiveCollectionID, const Ray&, RayResult&) -> bool may replace the
+     * hit of the world bounds with an exact one, e.g. from a triangle BVH of the mesh, and returns false on a miss.
+     * The ray it gets is clipped to the closest hit so far
+     */
+    template <typename Refine>
+    WorldRayHit pick(const Ray& ray, Refine&& refine) {
+        WorldRayHit closest{};
+        Ray clipped = ray;
+
+        raycast(ray, [&](const PrimitiveCollectionID collection, const RayResult& hit) {
+            RayResult result = hit;
+
+            if (refine(collection, clipped, result) && result.hasHit() && result.distance <= clipped.length) {
+                closest = {collection, result};
+                clipped.length = result.distance;
+            }
+            return clipped.length;
+        });
+        return closest;
+    }
+
+    WorldRayHit pick(const Ray& ray) {
+        return pick(ray, [](PrimitiveCollectionID, const Ray&, RayResult&) { return true; });
+    }
+
     template <IsPrimitiveArray Array>
     TPrimitiveArray<Array>& createPrimitiveArray(const size_t numPrimitives) {
         return *storage->createPrimitiveArray<Array>(numPrimitives);
@@ -1,12 +1,50 @@
 #pragma once
 #include "Primitive.h"
 #include "PrimitiveWorld.h"
+#include <bit>
+#include <algorithm>
+#include <cstring>
+#include <constexpr/assert.h>
+#include <Renderer/Common/Frustum.h>
+#include <Renderer/Common/OcclusionBuffer.h>
+#include <glm/gtx/component_wise.hpp>
+#include "LodSelector.h"
+#include <Renderer/Graphics/Features.h>
 
 using PrimitiveID = unsigned;
 
+/**
+ * Packed draw order within one collection type, compared as a plain integer:
+ * material in the top 32 bits, view depth in the low 32.
+ * The pipeline is not part of the key, pipelines are picked per collection type and every type has its own range
+ */
+class VisiblePrimitiveSortKey {
+    uint64_t key = 0;
+public:
+    constexpr static int DEPTH_BITS = 32;
+
+    VisiblePrimitiveSortKey() = default;
+
+    VisiblePrimitiveSortKey(const uint32_t material, const float depth)
+    : key(static_cast<uint64_t>(material) << DEPTH_BITS | depthBits(depth)) {}
+
+    /* non-negative floats order the same as their bit patterns */
+    static uint64_t depthBits(const float depth) {
+        return std::bit_cast<uint32_t>(std::max(depth, 0.0f));
+    }
+
+    uint32_t material() const { return static_cast<uint32_t>(key >> DEPTH_BITS); }
+    uint64_t value() const { return key; }
+
+    bool operator < (const VisiblePrimitiveSortKey& other) const { return key < other.key; }
+    bool operator == (const VisiblePrimitiveSortKey& other) const { return key == other.key; }
+};
+
 struct VisiblePrimitiveData {
     PrimitiveCollectionID collection{};
     PrimitiveID primitive{};
+    VisiblePrimitiveSortKey sortKey{};
+    uint8_t lod = 0;
 };
 
 template <IsPrimitiveCollection C>
@@ -28,6 +66,9 @@ public:
     PrimitiveID getPrimitiveID() const { return data->primitive; }
     PrimitiveCollectionID getCollectionID() const { return data->collection; }
 
+    /* detail level picked during culling, index into the primitive's PrimitiveLods */
+    uint8_t getLod() const { return data->lod; }
+
     PrimitiveReference<const typename C::PrimitiveType> getPrimitive() const {
         return getCollection()[data->primitive];
     }
@@ -105,34 +146,224 @@ public:
     }
 };
 
+/**
+ * Flat list of what a view sees, every array lives in the frame allocator and is dropped with it.
+ * draw appends in cull order, finalize groups the entries into one contiguous range per collection type.
+ * cull finalizes on its own, lists filled through draw are finalized by their Frame before any pass reads them
+ */
 class VisiblePrimitiveList {
-    Renderer* renderer{};
+    struct PendingPrimitive {
+        VisiblePrimitiveData data;
+        unsigned type;
+    };
+
+    struct TypeRange {
+        unsigned first = 0;
+        unsigned count = 0;
+    };
+
+    GraphicsAllocator* allocator{};
     PrimitiveWorld* world{};
 
-    std::vector<std::vector<VisiblePrimitiveData>> data{};
+    PendingPrimitive* pending{};
+    unsigned numPending = 0;
+    unsigned capPending = 0;
+
+    VisiblePrimitiveData* primitives{};
+    TypeRange* ranges{};
+    unsigned numTypes = 0;
+    unsigned capTypes = 0;
+
+    bool finalized = false;
+
+    /* the old array stays in the frame allocator until the frame ends */
+    template <typename T>
+    T* grow(T* data, const unsigned size, unsigned& capacity, const unsigned required) {
+        const unsigned newCapacity = std::max(capacity * 2, std::max(required, 64u));
+        T* newData = allocator->allocate<T>(newCapacity);
+
+        if (size) {
+            std::memcpy(newData, data, sizeof(T) * size);
+        }
+        capacity = newCapacity;
+        return newData;
+    }
 public:
     VisiblePrimitiveList() = default;
-    VisiblePrimitiveList(Renderer* renderer, PrimitiveWorld* world) : renderer(renderer), world(world) {}
+    VisiblePrimitiveList(GraphicsAllocator* allocator, PrimitiveWorld* world) : allocator(allocator), world(world) {}
+
+    void draw(const PrimitiveCollectionType type, const PrimitiveCollectionID collection, const PrimitiveID primitive, const VisiblePrimitiveSortKey sortKey = {}, const uint8_t lod = 0) {
+        cexpr::require(!finalized);
+
+        if (numPending == capPending) {
+            pending = grow(pending, numPending, capPending, numPending + 1);
+        }
+
+        if (type.id() >= numTypes) {
+            if (type.id() >= capTypes) {
+                ranges = grow(ranges, numTypes, capTypes, type.id() + 1);
+            }
+            std::fill(ranges + numTypes, ranges + type.id() + 1, TypeRange{});
+            numTypes = type.id() + 1;
+        }
+
+        pending[numPending++] = {{collection, primitive, sortKey, lod}, type.id()};
+        ++ranges[type.id()].count;
+    }
+
+    /**
+     * Adds the primitives of a visible collection that belong to any of passes, keyed by their material
+     * and the collection's depth in frustum's view.
+     * With a selector, primitives that carry a LOD chain get the level their bounding sphere projects to
+     */
+    void drawCollection(const Frustum& frustum, const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PassMask& passes, LodSelector* lodSelector = nullptr) {
+        const auto primitives = collection.getPrimitives();
+        const auto count = static_cast<PrimitiveID>(primitives.size());
+
+        const auto type = collection.getType();
+        const float depth = -(frustum.view * glm::vec4(collection.getWorldBounds().center, 1.0f)).z;
+
+        if (!lodSelector) {
+            for (PrimitiveID primitive = 0; primitive < count; ++primitive) {
+                const Primitive& prim = primitives[primitive];
+
+                if (prim.passes.any(passes)) {
+                    draw(type, id, primitive, VisiblePrimitiveSortKey(prim.material, depth));
+                }
+            }
+            return;
+        }
+
+        const Transform& transform = collection.getWorldTransform();
+        const glm::mat4 modelView = frustum.view * transform.createModel3D();
+        const float maxScale = glm::compMax(glm::abs(transform.scale));
+        const float viewportHeight = lodSelector->getSettings().viewportHeight;
+
+        for (PrimitiveID primitive = 0; primitive < count; ++primitive) {
+            const Primitive& prim = primitives[primitive];
+            uint8_t lod = 0;
 
-    void draw(const PrimitiveCollectionType type, const PrimitiveCollectionID collection, const PrimitiveID primitive) {
-        if (data.size() <= type.id()) {
-            data.resize(type.id() + 1);
+            if (!prim.passes.any(passes)) {
+                continue;
+            }
+
+            if (prim.lods.count > 1) {
+                const float viewDepth = -(modelView * glm::vec4(prim.localBounds.center, 1.0f)).z;
+                const float radius = glm::length(prim.localBounds.halfSize) * maxScale;
+                const float pixelsPerUnit = LodSelector::pixelsPerUnit(frustum, viewportHeight, viewDepth - radius);
+
+                // errors are authored in local space
+                lod = lodSelector->choose(id, primitive, count, prim.lods, pixelsPerUnit * maxScale);
+            }
+            draw(type, id, primitive, VisiblePrimitiveSortKey(prim.material, depth), lod);
+        }
+    }
+
+    /**
+     * Culls the world and adds the primitives of each visible collection that belong to any of passes.
+     * With an occlusion buffer built for the same view, collections behind its occluders are dropped too.
+     * With a LOD selector for the same view, every entry carries its chosen detail level.
+     * With the view's cull cache, the world reuses what it still knows from the view's earlier frames
+     */
+    void cull(const Frustum& frustum, const PassMask& passes, const OcclusionBuffer* occlusion = nullptr, LodSelector* lodSelector = nullptr, WorldCullCache* cache = nullptr) {
+        auto onVisible = [this, &frustum, &passes, occlusion, lodSelector](const PrimitiveCollectionID id) {
+            const PrimitiveCollection& collection = *world->getStorage().getCollectionUnchecked(id);
+
+            if (occlusion && !collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS) && !occlusion->isVisible(collection.getWorldBounds())) {
+                return;
+            }
+            drawCollection(frustum, id, collection, passes, lodSelector);
+        };
+
+        if (cache) {
+            world->cull(frustum, *cache, onVisible);
+        } else {
+            world->cull(frustum, onVisible);
+        }
+        finalize();
+    }
+
+    /**
+     * Culls count views of one world in a single traversal, lists[i] receives what frusta[i] sees of passes.
+     * Every list must have been created for the same world
+     */
+    static void cullViews(const Frustum* frusta, VisiblePrimitiveList* const* lists, const unsigned count, const PassMask& passes) {
+        if (!count) {
+            return;
+        }
+        PrimitiveWorld* world = lists[0]->world;
+
+        world->cullViews(frusta, count, [&](const PrimitiveCollectionID id, uint32_t viewMask) {
+            const PrimitiveCollection& collection = *world->getStorage().getCollectionUnchecked(id);
+
+            while (viewMask) {
+                const int view = std::countr_zero(viewMask);
+                lists[view]->drawCollection(frusta[view], id, collection, passes);
+                viewMask &= viewMask - 1;
+            }
+        });
+
+        for (unsigned view = 0; view < count; ++view) {
+            lists[view]->finalize();
+        }
+    }
+
+    /* counting sort by type, entries of one type keep their draw order */
+    void finalize() {
+        if (finalized) {
+            return;
+        }
+        finalized = true;
+
+        if (!numPending) {
+            return;
+        }
+
+        unsigned offset = 0;
+        for (unsigned i = 0; i < numTypes; ++i) {
+            ranges[i].first = offset;
+            offset += ranges[i].count;
+            ranges[i].count = 0;
+        }
+
+        primitives = allocator->allocate<VisiblePrimitiveData>(numPending);
+
+        for (unsigned i = 0; i < numPending; ++i) {
+            auto& range = ranges[pending[i].type];
+            primitives[range.first + range.count++] = pending[i].data;
         }
+    }
+
+    /* orders every type's range by sort key, call after finalize */
+    void sortByKey() {
+        cexpr::require(finalized);
 
-        data[type.id()].emplace_back(collection, primitive);
+        for (unsigned i = 0; i < numTypes; ++i) {
+            auto* first = primitives + ranges[i].first;
+
+            std::stable_sort(first, first + ranges[i].count, [](const VisiblePrimitiveData& a, const VisiblePrimitiveData& b) {
+                return a.sortKey < b.sortKey;
+            });
+        }
     }
 
     template <IsPrimitiveCollection C>
     VisiblePrimitiveIteratable<C> getVisible() const {
+        cexpr::require(finalized);
         auto id = PrimitiveCollectionType::of<C>();
 
-        if (data.size() <= id.id()) {
+        if (numTypes <= id.id() || !ranges[id.id()].count) {
             return VisiblePrimitiveIteratable<C>(world, nullptr, nullptr);
         }
-        return VisiblePrimitiveIteratable<C>(world, data[id.id()].data(), data[id.id()].data() + data[id.id()].size());
+        const auto& range = ranges[id.id()];
+        return VisiblePrimitiveIteratable<C>(world, primitives + range.first, primitives + range.first + range.count);
     }
 
     size_t getUniqueCollectionTypes() const {
-        return data.size();
+        return numTypes;
     }
-};
\ No newline at end of file
+
+    size_t size() const {
+        return numPending;
+    }
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <Math/Shapes/Ray.h>
 
 class WorldCullCallback {
 public:
@@ -14,4 +16,43 @@ public:
     void operator () (PrimitiveCollectionID collection) const {
         callback(instance, collection);
     }
-};
\ No newline at end of file
+};
+
+/* viewMask bit i is set when the collection is visible to the i-th frustum of the cull */
+class WorldMultiCullCallback {
+public:
+    constexpr static unsigned MAX_VIEWS = 32;
+
+    using CallbackFn = void(*)(const void* inst, PrimitiveCollectionID collection, uint32_t viewMask);
+private:
+    void* instance;
+    CallbackFn callback;
+public:
+    WorldMultiCullCallback(void* instance, CallbackFn callback) : instance(instance), callback(callback) {}
+
+    operator bool() const { return callback; }
+
+    void operator () (PrimitiveCollectionID collection, uint32_t viewMask) const {
+        callback(instance, collection, viewMask);
+    }
+};
+
+/**
+ * Receives a collection whose world bounds a ray hits and returns the length the ray keeps going for,
+ * hit.distance keeps only closer hits, the current length keeps every hit and 0 stops the query
+ */
+class WorldRayCallback {
+public:
+    using CallbackFn = float(*)(const void* inst, PrimitiveCollectionID collection, const RayResult& hit);
+private:
+    void* instance;
+    CallbackFn callback;
+public:
+    WorldRayCallback(void* instance, CallbackFn callback) : instance(instance), callback(callback) {}
+
+    operator bool() const { return callback; }
+
+    float operator () (PrimitiveCollectionID collection, const RayResult& hit) const {
+        return callback(instance, collection, hit);
+    }
+};
@@ -0,0 +1,100 @@
+#include "DynamicTreeWorld.h"
+#include <algorithm>
+
+void DynamicTreeWorld::insert(const PrimitiveCollectionID id, const AABB& bounds) {
+    if (collectionToProxy.size() <= id.id()) {
+        collectionToProxy.resize(id.id() + 1, DynamicAABBTree<Entry>::NULL_NODE);
+    }
+    collectionToProxy[id.id()] = tree.createProxy(bounds, Entry{id, bounds});
+}
+
+void DynamicTreeWorld::erase(const PrimitiveCollectionID id) {
+    int32_t& proxy = collectionToProxy[id.id()];
+
+    tree.destroyProxy(proxy);
+    proxy = DynamicAABBTree<Entry>::NULL_NODE;
+}
+
+void DynamicTreeWorld::onUpdateCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange& change) {
+    const bool wasInfinite = (change.getOldFlags() & PrimitiveCollectionFlags::INFINITE_BOUNDS) == PrimitiveCollectionFlags::INFINITE_BOUNDS;
+    const bool isInfinite = collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS);
+
+    if (wasInfinite || isInfinite) {
+        if (wasInfinite == isInfinite) {
+            return;
+        }
+
+        if (wasInfinite) {
+            std::erase(infiniteHandles, id);
+            insert(id, collection.getWorldBounds());
+        } else {
+            erase(id);
+            infiniteHandles.push_back(id);
+        }
+        return;
+    }
+
+    if (!change.isTransformChanged()) {
+        return;
+    }
+
+    const AABB bounds = collection.getWorldBounds();
+    const int32_t proxy = collectionToProxy[id.id()];
+
+    tree.getData(proxy).bounds = bounds;
+    tree.moveProxy(proxy, bounds);
+}
+
+void DynamicTreeWorld::onCull(const Frustum& frustum, const WorldCullCallback callback) {
+    for (auto inf : infiniteHandles) {
+        callback(inf);
+    }
+
+    const auto emit = [&](const int32_t proxy) {
+        callback(tree.getData(proxy).id);
+    };
+
+    tree.walk(uint8_t(0x3F), [&](const int32_t node, const AABB& fatBounds, const bool leaf, uint8_t& planeMask) {
+        if (leaf) {
+            if (frustum.isAABBInsideFrustum(tree.getData(node).bounds, planeMask)) {
+                emit(node);
+            }
+            return false;
+        }
+
+        switch (frustum.classifyAABB(fatBounds, planeMask)) {
+        case Frustum::Containment::OUTSIDE:
+            return false;
+        case Frustum::Containment::INSIDE:
+            tree.forEachLeaf(node, emit);
+            return false;
+        default:
+            return true;
+        }
+    });
+}
+
+void DynamicTreeWorld::onRaycast(const Ray& ray, const WorldRayCallback callback) {
+    tree.raycast(ray, [&](const int32_t proxy, const Ray& clipped) {
+        const Entry& entry = tree.getData(proxy);
+
+        if (const RayResult hit = clipped.intersects(entry.bounds); hit.hasHit()) {
+            return callback(entry.id, hit);
+        }
+        return clipped.length;
+    });
+}
+
+void DynamicTreeWorld::onOverlap(const AABB& box, const WorldCullCallback callback) {
+    for (auto inf : infiniteHandles) {
+        callback(inf);
+    }
+
+    tree.query(box, [&](const int32_t proxy) {
+        const Entry& entry = tree.getData(proxy);
+
+        if (entry.bounds.intersects(box)) {
+            callback(entry.id);
+        }
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <Math/DynamicAABBTree.h>
+#include <vector>
+#include <Renderer/Scene/Primitives/IPrimitive.h>
+#include <Renderer/Scene/Primitives/Primitive.h>
+#include <Renderer/Scene/Primitives/WorldCullCallback.h>
+#include <Renderer/Common/Frustum.h>
+#include "RendererAPI.h"
+
+/**
+ * World over a single dynamic AABB tree, no regions or cell sizes to tune. Suits scenes without a natural scale
+ * or with many small movers, a move inside the fat box of its leaf only updates the stored bounds
+ */
+class RENDERERAPI DynamicTreeWorld : public IPrimitiveWorld<DynamicTreeWorld> {
+    struct Entry {
+        PrimitiveCollectionID id{};
+        /* the exact world bounds, the tree only knows the fat box */
+        AABB bounds{};
+    };
+
+    DynamicAABBTree<Entry> tree;
+    std::vector<PrimitiveCollectionID> infiniteHandles{};
+    /* proxy of every finite collection by id.id() */
+    std::vector<int32_t> collectionToProxy{};
+
+    void insert(PrimitiveCollectionID id, const AABB& bounds);
+
+    void erase(PrimitiveCollectionID id);
+public:
+    /* margin is how far a collection's bounds may move before its leaf is reinserted */
+    explicit DynamicTreeWorld(float margin = 0.5f) : tree(margin) {}
+
+    void onAddCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
+        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
+            infiniteHandles.push_back(id);
+            return;
+        }
+        insert(id, collection.getWorldBounds());
+    }
+
+    void onUpdateCollection(PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange &change);
+
+    void onRemoveCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
+        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
+            std::erase(infiniteHandles, id);
+            return;
+        }
+        erase(id);
+    }
+
+    /**
+     * Walks the tree with the planes a node still straddles, subtrees fully inside the frustum are emitted
+     * without further tests and leaves are tested against their exact bounds
+     */
+    void onCull(const Frustum& frustum, WorldCullCallback callback);
+
+    /* walks the fat boxes nearest first, the callback only sees collections whose exact bounds are hit */
+    void onRaycast(const Ray& ray, WorldRayCallback callback);
+
+    void onOverlap(const AABB& box, WorldCullCallback callback);
+
+    const DynamicAABBTree<Entry>& getTree() const {
+        return tree;
+    }
+};
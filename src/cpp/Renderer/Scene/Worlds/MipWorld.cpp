@@ -1,53 +1,123 @@
 #include "MipWorld.h"
 #include <glm/gtx/component_wise.hpp>
 #include <Math/Shapes/geom.h>
+#include <algorithm>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/blocked_range.h>
+#include <limits>
+#include <tuple>
 
 MipWorld::Region::Entities::Entities() {
     myEntities.emplace_back();
+    myBounds.emplace_back();
+    myLive.emplace_back(0);
 }
 
-MipWorld::Region::LocationHandle MipWorld::Region::Entities::add(const EntryPosition &ePosition) {
+MipWorld::Region::LocationHandle MipWorld::Region::Entities::add(const EntryPosition &ePosition, const AABB& worldBox) {
+    ++liveCount;
+
     if (!myFreeHandles.empty()) {
         auto handle = myFreeHandles.back();
         myFreeHandles.pop_back();
         myEntities[handle.index] = {ePosition};
+        myBounds[handle.index] = worldBox;
+        myLive[handle.index] = 1;
         return handle;
     }
     myEntities.emplace_back(ePosition);
+    myBounds.emplace_back(worldBox);
+    myLive.emplace_back(1);
     return LocationHandle{static_cast<unsigned>(myEntities.size() - 1)};
 }
 
 void MipWorld::Region::Entities::free(const LocationHandle handle) {
+    myLive[handle.index] = 0;
+    --liveCount;
     myFreeHandles.push_back(handle);
 }
 
-MipWorld::Region::LocationHandle MipWorld::Region::createEntityHandle(EntryPosition ePosition) {
-    return entities.add(ePosition);
+MipWorld::Region::LocationHandle MipWorld::Region::createEntityHandle(EntryPosition ePosition, const AABB& worldBox) {
+    return entities.add(ePosition, worldBox);
+}
+
+glm::ivec3 MipWorld::Region::cellOf(const int mip, const int index) const {
+    const int cellsPerAxis = maxSize / (maxSize >> mip);
+
+    return {
+        index % cellsPerAxis,
+        (index / cellsPerAxis) % cellsPerAxis,
+        index / (cellsPerAxis * cellsPerAxis)
+    };
+}
+
+void MipWorld::Region::adjustSubtree(const MipPosition mipPosition, const int delta) {
+    glm::ivec3 cell = cellOf(mipPosition.mip, mipPosition.index);
+
+    for (int mip = mipPosition.mip; mip >= 0; --mip) {
+        levels[mip][getAt(mip, cell.x, cell.y, cell.z)].subtreeEntities += delta;
+        cell /= 2;
+    }
 }
 
 MipWorld::Region::Region(const CreateInfo &info): infinite(!info.isFinite), position(info.position), maxLevels(info.getMipCount()), maxSize(info.highestMipSize) {
+    assert(isInfinite() || info.getMipCount() != -1);
+
+    makeResident();
+}
+
+void MipWorld::Region::link(const LocationHandle handle, const MipPosition mipPosition) {
+    auto& level = levels[mipPosition];
+
+    entities[handle] = {mipPosition, level.next()};
+    level.add(handle);
+    adjustSubtree(mipPosition, 1);
+}
+
+void MipWorld::Region::makeResident() {
+    if (resident) {
+        return;
+    }
+    resident = true;
+
     if (isInfinite()) {
         levels.resize(1);
         levels[0].resize(1);
-        return;
-    }
-    assert(info.getMipCount() != -1);
+    } else {
+        levels.resize(maxLevels);
 
-    levels.resize(maxLevels);
+        int entries = 1;
+        for (int lvl = 0; lvl < maxLevels; ++lvl) {
+            levels[lvl].resize(entries);
+            entries *= 8;
+        }
+    }
 
-    int entries = 1;
+    entities.forEachLive([&](const LocationHandle handle) {
+        link(handle, getMipPosition(entities.bounds(handle)));
+    });
+}
 
-    int size = maxSize;
+void MipWorld::Region::evict() {
+    if (!resident || isInfinite()) {
+        return;
+    }
+    resident = false;
 
-    for (int lvl = 0; lvl < maxLevels; ++lvl) {
-        auto& level = levels[lvl];
+    std::vector<std::vector<MipLevel>>().swap(levels.myLevels);
+}
 
-        level.resize(entries);
+size_t MipWorld::Region::residentBytes() const {
+    if (isInfinite()) {
+        return sizeof(MipLevel);
+    }
 
-        std::cout << "Mip: " << lvl << " Entries: " << entries << ", Size: " << size << std::endl;
+    size_t cells = 0;
+    size_t entries = 1;
+    for (int lvl = 0; lvl < maxLevels; ++lvl) {
+        cells += entries;
         entries *= 8;
-        size /= 2;
     }
+    return cells * sizeof(MipLevel);
 }
 
 MipWorld::Region::MipPosition MipWorld::Region::getMipPosition(AABB aabb) const {
@@ -87,22 +157,30 @@ MipWorld::Region::MipPosition MipWorld::Region::getMipPosition(AABB aabb) const
 }
 
 MipWorld::Region::LocationHandle MipWorld::Region::addEntity(const AABB& worldBox) {
-    auto mipPos = getMipPosition(worldBox);
-    auto& mipData = levels[mipPos];
+    auto h = createEntityHandle({}, worldBox);
 
-    auto h = createEntityHandle({mipPos, mipData.next()});
-    levels[mipPos].add(h);
+    if (resident) {
+        link(h, getMipPosition(worldBox));
+    }
     return h;
 }
 
 void MipWorld::Region::updateEntity(const LocationHandle handle, const AABB& worldBox) {
     assert(handle.id() != 0);
 
-    auto newMipPosition = getMipPosition(worldBox);
+    entities.bounds(handle) = worldBox;
 
+    if (!resident) {
+        return;
+    }
+
+    auto newMipPosition = getMipPosition(worldBox);
     auto& liveEntityPosition = entities[handle];
 
     if (liveEntityPosition.mip != newMipPosition) {
+        adjustSubtree(liveEntityPosition.mip, -1);
+        adjustSubtree(newMipPosition, 1);
+
         auto& oldMipLevel = levels[liveEntityPosition.mip];
         auto& newMipLevel = levels[newMipPosition];
 
@@ -130,9 +208,16 @@ void MipWorld::Region::updateEntity(const LocationHandle handle, const AABB& wor
 void MipWorld::Region::removeEntity(const LocationHandle handle) {
     assert(handle.id() != 0);
 
+    if (!resident) {
+        entities[handle] = {};
+        entities.free(handle);
+        return;
+    }
+
     auto& liveEntityPosition = entities[handle];
 
     auto& mipData = levels[liveEntityPosition.mip];
+    adjustSubtree(liveEntityPosition.mip, -1);
 
     auto& mipLastEntityHandle = mipData.back();
 
@@ -153,3 +238,562 @@ int MipWorld::Region::getAt(const int mip, const int x, const int y, const int z
     int numRegions = maxSize / mipSize;
     return x + y * numRegions + z * numRegions * numRegions;
 }
+
+MipWorld::RegionCollectionPair& MipWorld::findOrCreateRegion(const glm::ivec3 regionCoords) {
+    regionMin = glm::min(regionMin, regionCoords);
+    regionMax = glm::max(regionMax, regionCoords);
+
+    return regions.findOrCreate(regionCoords, [&] {
+        return RegionCollectionPair(
+            Region(CreateInfo(regionCoords * regionHighestSize, regionLowestSize, regionHighestSize, true))
+        );
+    });
+}
+
+void MipWorld::releaseRegionIfEmpty(const glm::ivec3 regionCoords) {
+    if (const auto* region = regions.find(regionCoords); region && !region->region.size()) {
+        regions.erase(regionCoords);
+    }
+}
+
+void MipWorld::insertIntoRegion(RegionCollectionPair& region, const glm::ivec3 regionCoords, const PrimitiveCollectionID id, const AABB& bounds) {
+    const auto handle = region.region.addEntity(bounds);
+    touch(region);
+
+    if (region.handles.size() <= handle.id()) {
+        region.handles.resize(handle.id() + 64);
+    }
+
+    region.handles[handle.id()] = id;
+
+    if (collectionToHandle.size() <= id.id()) {
+        collectionToHandle.resize(id.id() + 512);
+    }
+
+    auto& location = collectionToHandle[id.id()];
+    location.region = regionCoords;
+    location.handle = handle;
+}
+
+void MipWorld::eraseFromRegion(const PrimitiveCollectionID id) {
+    const auto& location = collectionToHandle[id.id()];
+
+    auto& pair = *regions.find(location.region);
+
+    pair.region.removeEntity(location.handle);
+    pair.freeHandles.push_back(location.handle.id());
+    touch(pair);
+
+    releaseRegionIfEmpty(location.region);
+}
+
+void MipWorld::queueMigration(const PrimitiveCollectionID id, const glm::ivec3 to, const AABB& bounds) {
+    auto& location = collectionToHandle[id.id()];
+
+    if (location.pendingMigration != CollectionLocation::NO_MIGRATION) {
+        auto& migration = pendingMigrations[location.pendingMigration];
+        migration.to = to;
+        migration.bounds = bounds;
+        return;
+    }
+
+    location.pendingMigration = static_cast<unsigned>(pendingMigrations.size());
+    pendingMigrations.push_back({id, location.region, to, bounds});
+}
+
+void MipWorld::cancelMigration(const PrimitiveCollectionID id) {
+    if (collectionToHandle.size() <= id.id()) {
+        return;
+    }
+
+    auto& location = collectionToHandle[id.id()];
+
+    if (location.pendingMigration != CollectionLocation::NO_MIGRATION) {
+        pendingMigrations[location.pendingMigration].cancelled = true;
+        location.pendingMigration = CollectionLocation::NO_MIGRATION;
+    }
+}
+
+void MipWorld::onUpdateCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange& change) {
+    const bool wasInfinite = (change.getOldFlags() & PrimitiveCollectionFlags::INFINITE_BOUNDS) == PrimitiveCollectionFlags::INFINITE_BOUNDS;
+    const bool isInfinite = collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS);
+
+    if (wasInfinite || isInfinite) {
+        if (wasInfinite == isInfinite) {
+            return;
+        }
+
+        if (wasInfinite) {
+            std::erase(infiniteHandles, id);
+            onAddCollection(id, collection);
+        } else {
+            cancelMigration(id);
+            eraseFromRegion(id);
+            infiniteHandles.push_back(id);
+        }
+        return;
+    }
+
+    if (!change.isTransformChanged()) {
+        return;
+    }
+
+    const AABB bounds = collection.getWorldBounds();
+    const glm::ivec3 regionCoords = regionOf(bounds);
+    auto& location = collectionToHandle[id.id()];
+
+    if (regionCoords != location.region) {
+        queueMigration(id, regionCoords, bounds);
+        return;
+    }
+
+    // moved back into its region before the queued migration ran
+    cancelMigration(id);
+
+    // relinks only when the mip cell changes
+    auto& region = *regions.find(regionCoords);
+    region.region.updateEntity(location.handle, bounds);
+    touch(region);
+}
+
+void MipWorld::flushMigrations() {
+    if (pendingMigrations.empty()) {
+        return;
+    }
+
+    std::erase_if(pendingMigrations, [](const Migration& migration) { return migration.cancelled; });
+
+    auto byRegion = [](const glm::ivec3& a, const glm::ivec3& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    };
+
+    std::sort(pendingMigrations.begin(), pendingMigrations.end(), [&](const Migration& a, const Migration& b) {
+        return byRegion(a.from, b.from);
+    });
+
+    RegionCollectionPair* region = nullptr;
+
+    for (size_t i = 0; i < pendingMigrations.size(); ++i) {
+        auto& migration = pendingMigrations[i];
+
+        if (i == 0 || migration.from != pendingMigrations[i - 1].from) {
+            region = regions.find(migration.from);
+        }
+
+        const auto& location = collectionToHandle[migration.id.id()];
+
+        region->region.removeEntity(location.handle);
+        region->freeHandles.push_back(location.handle.id());
+        touch(*region);
+    }
+
+    // emptied regions are released once every removal ran, so the cached pointer above stays valid
+    for (size_t i = 0; i < pendingMigrations.size(); ++i) {
+        if (i == 0 || pendingMigrations[i].from != pendingMigrations[i - 1].from) {
+            releaseRegionIfEmpty(pendingMigrations[i].from);
+        }
+    }
+
+    std::sort(pendingMigrations.begin(), pendingMigrations.end(), [&](const Migration& a, const Migration& b) {
+        return byRegion(a.to, b.to);
+    });
+
+    for (size_t i = 0; i < pendingMigrations.size(); ++i) {
+        auto& migration = pendingMigrations[i];
+
+        if (i == 0 || migration.to != pendingMigrations[i - 1].to) {
+            region = &findOrCreateRegion(migration.to);
+        }
+
+        insertIntoRegion(*region, migration.to, migration.id, migration.bounds);
+        collectionToHandle[migration.id.id()].pendingMigration = CollectionLocation::NO_MIGRATION;
+    }
+
+    pendingMigrations.clear();
+}
+
+void MipWorld::updateResidency(const std::span<const glm::vec3> focusPoints, const float radius, const size_t memoryBudget) {
+    struct Candidate {
+        float distance;
+        RegionCollectionPair* region;
+    };
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(regions.size());
+
+    regions.forEach([&](const glm::ivec3&, RegionCollectionPair& region) {
+        const AABB box = region.region.bounds();
+        float nearest = std::numeric_limits<float>::max();
+
+        for (const auto& point : focusPoints) {
+            nearest = std::min(nearest, glm::distance(point, glm::clamp(point, box.min(), box.max())));
+        }
+        candidates.push_back({nearest, &region});
+    });
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.distance < b.distance;
+    });
+
+    // evict before building so the budget is never exceeded in between
+    size_t used = 0;
+    size_t keep = 0;
+
+    for (; keep < candidates.size() && candidates[keep].distance <= radius; ++keep) {
+        const size_t bytes = candidates[keep].region->region.residentBytes();
+
+        if (used + bytes > memoryBudget) {
+            break;
+        }
+        used += bytes;
+    }
+
+    for (size_t i = keep; i < candidates.size(); ++i) {
+        candidates[i].region->region.evict();
+    }
+
+    for (size_t i = 0; i < keep; ++i) {
+        candidates[i].region->region.makeResident();
+    }
+}
+
+void MipWorld::cullRegion(const Frustum& frustum, RegionCollectionPair& region, ThreadCullList& out) const {
+    auto& handles = region.handles;
+
+    region.region.cull(frustum, [&](const Region::LocationHandle& handle) {
+        out.visible.push_back(handles[handle.id()]);
+    });
+}
+
+void MipWorld::cullRegionViews(const Frustum* frusta, const unsigned count, RegionCollectionPair& region, ThreadCullList& out) const {
+    auto& handles = region.handles;
+
+    region.region.cullViews(frusta, count, [&](const Region::LocationHandle& handle, const uint32_t viewMask) {
+        out.visible.push_back(handles[handle.id()]);
+        out.viewMasks.push_back(viewMask);
+    });
+}
+
+void MipWorld::gatherRegions(const Frustum& frustum, std::vector<RegionCollectionPair*>& out) {
+    gatherRegions(frustum.asAABB(), out);
+}
+
+void MipWorld::gatherRegions(const AABB& box, std::vector<RegionCollectionPair*>& out) {
+    // entities are binned by center, so they overhang their region by up to half of it
+    const glm::vec3 overhang(static_cast<float>(regionHighestSize) * 0.5f);
+
+    glm::ivec3 min = geom::floorDiv3(box.min() - overhang, regionHighestSize);
+    glm::ivec3 max = geom::floorDiv3(box.max() + overhang - glm::vec3(1e-6f), regionHighestSize);
+
+    for (int z = min.z; z <= max.z; ++z) {
+        for (int y = min.y; y <= max.y; ++y) {
+            for (int x = min.x; x <= max.x; ++x) {
+                if (auto* region = regions.find(glm::ivec3(x, y, z))) {
+                    out.push_back(region);
+                }
+            }
+        }
+    }
+}
+
+template <typename CullFn, typename EmitFn>
+void MipWorld::cullGathered(CullScratch& scratch, CullFn&& cullFn, EmitFn&& emitFn) {
+    if (scratch.regions.size() < PARALLEL_CULL_MIN_REGIONS) {
+        auto& list = scratch.lists.local();
+
+        for (auto* region : scratch.regions) {
+            list.visible.clear();
+            list.viewMasks.clear();
+            cullFn(*region, list);
+
+            emitFn(list, 0u, static_cast<unsigned>(list.visible.size()));
+        }
+        return;
+    }
+
+    for (auto& list : scratch.lists) {
+        list.visible.clear();
+        list.viewMasks.clear();
+        list.spans.clear();
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, scratch.regions.size(), PARALLEL_CULL_GRAIN), [&](const tbb::blocked_range<size_t>& range) {
+        auto& list = scratch.lists.local();
+
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            const auto first = static_cast<unsigned>(list.visible.size());
+            cullFn(*scratch.regions[i], list);
+
+            list.spans.push_back({static_cast<unsigned>(i), &list, first, static_cast<unsigned>(list.visible.size())});
+        }
+    });
+
+    scratch.spans.clear();
+    for (auto& list : scratch.lists) {
+        scratch.spans.insert(scratch.spans.end(), list.spans.begin(), list.spans.end());
+    }
+
+    std::sort(scratch.spans.begin(), scratch.spans.end(), [](const CullSpan& a, const CullSpan& b) {
+        return a.order < b.order;
+    });
+
+    for (auto& span : scratch.spans) {
+        emitFn(*span.list, span.first, span.last);
+    }
+}
+
+void MipWorld::onCull(const Frustum& frustum, const WorldCullCallback callback) {
+    for (auto inf : infiniteHandles) {
+        callback(inf);
+    }
+
+    ScopedCullScratch scratch(cullScratch.local());
+    gatherRegions(frustum, scratch->regions);
+
+    cullGathered(*scratch, [&](RegionCollectionPair& region, ThreadCullList& list) {
+        cullRegion(frustum, region, list);
+    }, [&](const ThreadCullList& list, const unsigned first, const unsigned last) {
+        for (unsigned i = first; i < last; ++i) {
+            callback(list.visible[i]);
+        }
+    });
+}
+
+void MipWorld::onCullViews(const Frustum* frusta, const unsigned count, const WorldMultiCullCallback callback) {
+    if (!count) {
+        return;
+    }
+
+    const uint32_t allViews = count == 32 ? ~0u : (1u << count) - 1;
+
+    for (auto inf : infiniteHandles) {
+        callback(inf, allViews);
+    }
+
+    ScopedCullScratch scratch(cullScratch.local());
+    for (unsigned view = 0; view < count; ++view) {
+        gatherRegions(frusta[view], scratch->regions);
+    }
+
+    // views overlap, each region is walked once and in grid order whatever the view order
+    std::sort(scratch->regions.begin(), scratch->regions.end(), [](const RegionCollectionPair* a, const RegionCollectionPair* b) {
+        const glm::ivec3 pa = a->region.getPosition();
+        const glm::ivec3 pb = b->region.getPosition();
+        return std::tie(pa.z, pa.y, pa.x) < std::tie(pb.z, pb.y, pb.x);
+    });
+    scratch->regions.erase(std::unique(scratch->regions.begin(), scratch->regions.end()), scratch->regions.end());
+
+    cullGathered(*scratch, [&](RegionCollectionPair& region, ThreadCullList& list) {
+        cullRegionViews(frusta, count, region, list);
+    }, [&](const ThreadCullList& list, const unsigned first, const unsigned last) {
+        for (unsigned i = first; i < last; ++i) {
+            callback(list.visible[i], list.viewMasks[i]);
+        }
+    });
+}
+
+bool MipWorld::CullCache::RegionEntry::isReusable(const Frustum& frustum) const {
+    for (int i = 0; i < 6; ++i) {
+        const glm::vec3 normalDelta = glm::vec3(frustum.planes[i]) - glm::vec3(planes[i]);
+        const float offsetDelta = frustum.planes[i].w - planes[i].w;
+
+        // a box within extent of origin changes its distance to the plane by at most this much
+        const float moved = std::abs(glm::dot(normalDelta, origin) + offsetDelta) + glm::length(normalDelta) * extent;
+
+        if (moved >= margins[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MipWorld::cullRegionCached(const Frustum& frustum, RegionCollectionPair& region, CullCache::RegionEntry& entry) const {
+    MarginTester tester(frustum, region.region.bounds().center);
+    auto& handles = region.handles;
+
+    entry.visible.clear();
+    region.region.cullWith(tester, [&](const Region::LocationHandle& handle) {
+        entry.visible.push_back(handles[handle.id()]);
+    });
+
+    entry.version = region.version;
+    std::copy_n(frustum.planes, 6, entry.planes);
+    std::copy_n(tester.margins, 6, entry.margins);
+    entry.origin = tester.origin;
+    entry.extent = tester.extent;
+}
+
+void MipWorld::onCull(const Frustum& frustum, const WorldCullCallback callback, CullCache& cache) {
+    for (auto inf : infiniteHandles) {
+        callback(inf);
+    }
+
+    ScopedCullScratch scratch(cullScratch.local());
+    gatherRegions(frustum, scratch->regions);
+
+    cache.order.clear();
+    cache.stale.clear();
+    cache.reused = 0;
+
+    for (auto* region : scratch->regions) {
+        const glm::ivec3 coords = geom::floorDiv3(glm::vec3(region->region.getPosition()), regionHighestSize);
+        auto& entry = cache.entries.findOrCreate(coords, [] { return CullCache::RegionEntry{}; });
+
+        entry.used = true;
+        cache.order.push_back(&entry);
+
+        if (entry.version != region->version || !entry.isReusable(frustum)) {
+            cache.stale.emplace_back(region, &entry);
+        } else {
+            ++cache.reused;
+        }
+    }
+
+    if (cache.stale.size() < PARALLEL_CULL_MIN_REGIONS) {
+        for (auto [region, entry] : cache.stale) {
+            cullRegionCached(frustum, *region, *entry);
+        }
+    } else {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, cache.stale.size(), PARALLEL_CULL_GRAIN), [&](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                cullRegionCached(frustum, *cache.stale[i].first, *cache.stale[i].second);
+            }
+        });
+    }
+
+    for (auto* entry : cache.order) {
+        for (auto id : entry->visible) {
+            callback(id);
+        }
+    }
+
+    // regions that left the view are dropped, their next result could not be reused anyway
+    cache.unused.clear();
+    cache.entries.forEach([&](const glm::ivec3& coords, CullCache::RegionEntry& entry) {
+        if (!entry.used) {
+            cache.unused.push_back(coords);
+        }
+        entry.used = false;
+    });
+
+    for (auto coords : cache.unused) {
+        cache.entries.erase(coords);
+    }
+}
+
+void MipWorld::onRaycast(const Ray& ray, const WorldRayCallback callback) {
+    if (regions.empty()) {
+        return;
+    }
+
+    const auto size = static_cast<float>(regionHighestSize);
+    const float overhang = size * 0.5f;
+
+    // no region lies outside these, the walk starts and ends on them instead of at the ray's ends
+    const AABB occupied = AABB::fromTo(glm::vec3(regionMin) * size - overhang, glm::vec3(regionMax + 1) * size + overhang);
+
+    float tEnter = 0.0f;
+    float tExit = ray.length;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (ray.direction[axis] == 0.0f) {
+            if (ray.origin[axis] < occupied.min()[axis] || ray.origin[axis] > occupied.max()[axis]) {
+                return;
+            }
+            continue;
+        }
+        const float t0 = (occupied.min()[axis] - ray.origin[axis]) / ray.direction[axis];
+        const float t1 = (occupied.max()[axis] - ray.origin[axis]) / ray.direction[axis];
+
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    }
+
+    if (tEnter > tExit) {
+        return;
+    }
+
+    /**
+     * Entities overhang their region by up to half of it, so the walk steps through a grid shifted by
+     * half a region: cell k then meets the grown bounds of regions k - 1 and k along every axis.
+     * Every cell a region meets is contiguous along the ray, so it was seen before exactly when the
+     * previous cell met it too
+     */
+    const glm::vec3 start = ray.getPoint(tEnter) + overhang;
+    glm::ivec3 cell = glm::ivec3(glm::floor(start / size));
+
+    glm::ivec3 step(0);
+    glm::vec3 tNext(std::numeric_limits<float>::max());
+    glm::vec3 tDelta(std::numeric_limits<float>::max());
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (ray.direction[axis] > 0.0f) {
+            step[axis] = 1;
+            tNext[axis] = tEnter + ((static_cast<float>(cell[axis] + 1) * size - start[axis]) / ray.direction[axis]);
+            tDelta[axis] = size / ray.direction[axis];
+        } else if (ray.direction[axis] < 0.0f) {
+            step[axis] = -1;
+            tNext[axis] = tEnter + ((static_cast<float>(cell[axis]) * size - start[axis]) / ray.direction[axis]);
+            tDelta[axis] = -size / ray.direction[axis];
+        }
+    }
+
+    Ray clipped = ray;
+    glm::ivec3 previous{};
+    bool first = true;
+
+    for (float t = tEnter; t <= std::min(clipped.length, tExit);) {
+        for (int corner = 0; corner < 8; ++corner) {
+            const glm::ivec3 coords = cell - glm::ivec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+
+            if (!first && glm::all(glm::greaterThanEqual(coords, previous - 1)) && glm::all(glm::lessThanEqual(coords, previous))) {
+                continue;
+            }
+
+            auto* region = regions.find(coords);
+            if (!region) {
+                continue;
+            }
+
+            const AABB grown = AABB::fromTo(glm::vec3(coords) * size - overhang, glm::vec3(coords + 1) * size + overhang);
+            if (!clipped.intersects(grown).hasHit()) {
+                continue;
+            }
+
+            auto& handles = region->handles;
+            region->region.raycast(clipped, [&](const Region::LocationHandle& handle, const RayResult& hit) {
+                return callback(handles[handle.id()], hit);
+            });
+        }
+
+        previous = cell;
+        first = false;
+
+        const int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+        t = tNext[axis];
+        cell[axis] += step[axis];
+        tNext[axis] += tDelta[axis];
+    }
+}
+
+void MipWorld::onOverlap(const AABB& box, const WorldCullCallback callback) {
+    for (auto inf : infiniteHandles) {
+        callback(inf);
+    }
+
+    ScopedCullScratch scratch(cullScratch.local());
+    gatherRegions(box, scratch->regions);
+
+    cullGathered(*scratch, [&](RegionCollectionPair& region, ThreadCullList& list) {
+        Region::BoxTester tester{box};
+        auto& handles = region.handles;
+
+        region.region.cullWith(tester, [&](const Region::LocationHandle& handle) {
+            list.visible.push_back(handles[handle.id()]);
+        });
+    }, [&](const ThreadCullList& list, const unsigned first, const unsigned last) {
+        for (unsigned i = first; i < last; ++i) {
+            callback(list.visible[i]);
+        }
+    });
+}
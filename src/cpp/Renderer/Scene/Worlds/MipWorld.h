@@ -1,9 +1,16 @@
 #pragma once
 #include <Math/Shapes/geom.h>
+#include <memory/small_vector.h>
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <memory>
+#include <oneapi/tbb/enumerable_thread_specific.h>
 #include <Renderer/Scene/Primitives/IPrimitive.h>
 #include <Renderer/Scene/Primitives/Primitive.h>
 #include <Renderer/Scene/Primitives/WorldCullCallback.h>
 #include <Renderer/Common/Frustum.h>
+#include "SparsePagedGrid.h"
 #include "RendererAPI.h"
 
 class RENDERERAPI MipWorld : public IPrimitiveWorld<MipWorld> {
@@ -67,7 +74,8 @@ public:
         };
     private:
         struct MipLevel {
-            std::vector<LocationHandle> localEntities{};
+            mem::small_vector<LocationHandle, 2, mem::default_allocator<LocationHandle>, mem::doubling_schema, unsigned> localEntities{};
+            unsigned subtreeEntities = 0; // entities in this cell and every cell below it
 
             unsigned next() const {
                 return localEntities.size();
@@ -124,17 +132,38 @@ public:
 
         struct Entities {
             std::vector<EntryPosition> myEntities;
+            std::vector<AABB> myBounds;
             std::vector<LocationHandle> myFreeHandles{};
+            std::vector<unsigned char> myLive;
+            unsigned liveCount = 0;
 
             Entities();
 
-            LocationHandle add(const EntryPosition& ePosition);
+            LocationHandle add(const EntryPosition& ePosition, const AABB& worldBox);
 
             EntryPosition& operator [] (const LocationHandle& handle) {
                 return myEntities[handle.index];
             }
 
+            AABB& bounds(const LocationHandle& handle) {
+                return myBounds[handle.index];
+            }
+
+            const AABB& bounds(const LocationHandle& handle) const {
+                return myBounds[handle.index];
+            }
+
             void free(LocationHandle handle);
+
+            /* fn(LocationHandle), skips the null handle and freed slots */
+            template <typename Fn>
+            void forEachLive(Fn&& fn) const {
+                for (unsigned i = 1; i < myLive.size(); ++i) {
+                    if (myLive[i]) {
+                        fn(LocationHandle{i});
+                    }
+                }
+            }
         };
 
         Levels levels;
@@ -146,13 +175,185 @@ public:
         Entities entities;
 
         bool infinite = false;
+        bool resident = false;
+
+        void link(LocationHandle handle, MipPosition mipPosition);
+
+        glm::ivec3 cellOf(int mip, int index) const;
+
+        void adjustSubtree(MipPosition mipPosition, int delta);
+
+        /**
+         * Bounds every entity of a cell fits in, entities are binned by their min corner
+         * into a cell at least twice their size so they may overhang it by half a cell
+         */
+        AABB looseCellBounds(const int mip, const glm::ivec3 cell) const {
+            const float cellSize = static_cast<float>(maxSize >> mip);
+            const glm::vec3 min = glm::vec3(position) + glm::vec3(cell) * cellSize;
+
+            return AABB(min + cellSize * 0.5f, glm::vec3(cellSize));
+        }
+
+        template <typename Tester, typename Fn>
+        void cullCell(Tester& tester, const int mip, const glm::ivec3 cell, uint8_t planeMask, Fn& fn) {
+            auto& level = levels[mip][getAt(mip, cell.x, cell.y, cell.z)];
+
+            if (!level.subtreeEntities) {
+                return;
+            }
+
+            if (planeMask && tester.classify(looseCellBounds(mip, cell), planeMask) == Frustum::Containment::OUTSIDE) {
+                return;
+            }
+
+            for (auto handle : level) {
+                if (!planeMask || tester.isVisible(entities.bounds(handle), planeMask)) {
+                    fn(handle);
+                }
+            }
+
+            if (mip + 1 >= maxLevels) {
+                return;
+            }
+
+            for (int child = 0; child < 8; ++child) {
+                const glm::ivec3 offset(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+                cullCell(tester, mip + 1, cell * 2 + offset, planeMask, fn);
+            }
+        }
+
+        /* views of a multi-view cull that may still see a cell, each with the planes the cell still straddles */
+        struct ViewPlaneMasks {
+            uint8_t planes[WorldMultiCullCallback::MAX_VIEWS]{};
+            uint32_t active = 0;
+        };
+
+        uint32_t visibleViews(const Frustum* frusta, const ViewPlaneMasks& masks, const AABB& box) const {
+            uint32_t visible = 0;
+
+            for (uint32_t views = masks.active; views; views &= views - 1) {
+                const int view = std::countr_zero(views);
+
+                if (!masks.planes[view] || frusta[view].isAABBInsideFrustum(box, masks.planes[view])) {
+                    visible |= 1u << view;
+                }
+            }
+            return visible;
+        }
+
+        /* drops the views that cannot see box and narrows the plane masks of the rest */
+        static void classifyViews(const Frustum* frusta, const AABB& box, ViewPlaneMasks& masks) {
+            for (uint32_t views = masks.active; views; views &= views - 1) {
+                const int view = std::countr_zero(views);
+
+                if (masks.planes[view] && frusta[view].classifyAABB(box, masks.planes[view]) == Frustum::Containment::OUTSIDE) {
+                    masks.active &= ~(1u << view);
+                }
+            }
+        }
+
+        template <typename Fn>
+        void cullCellViews(const Frustum* frusta, const int mip, const glm::ivec3 cell, ViewPlaneMasks masks, Fn& fn) {
+            auto& level = levels[mip][getAt(mip, cell.x, cell.y, cell.z)];
+
+            if (!level.subtreeEntities) {
+                return;
+            }
+
+            classifyViews(frusta, looseCellBounds(mip, cell), masks);
+
+            if (!masks.active) {
+                return;
+            }
+
+            for (auto handle : level) {
+                if (const uint32_t visible = visibleViews(frusta, masks, entities.bounds(handle))) {
+                    fn(handle, visible);
+                }
+            }
+
+            if (mip + 1 >= maxLevels) {
+                return;
+            }
+
+            for (int child = 0; child < 8; ++child) {
+                const glm::ivec3 offset(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+                cullCellViews(frusta, mip + 1, cell * 2 + offset, masks, fn);
+            }
+        }
+        /* fn(LocationHandle, const RayResult&) -> float, the ray is clipped to what fn returns and stops at 0 */
+        template <typename Fn>
+        void raycastEntity(Ray& ray, const LocationHandle handle, Fn& fn) {
+            if (const RayResult hit = ray.intersects(entities.bounds(handle)); hit.hasHit()) {
+                const float length = fn(handle, hit);
+                ray.length = std::min(ray.length, length > 0.0f ? length : -1.0f);
+            }
+        }
+
+        /* visits the children of a cell nearest first, children the clipped ray no longer reaches are skipped */
+        template <typename Fn>
+        void raycastCell(Ray& ray, const int mip, const glm::ivec3 cell, Fn& fn) {
+            struct Candidate {
+                float distance;
+                glm::ivec3 cell;
+            };
+            Candidate candidates[8];
+            int count = 0;
+
+            for (int child = 0; child < 8; ++child) {
+                const glm::ivec3 offset(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+                const glm::ivec3 childCell = cell * 2 + offset;
+
+                if (!levels[mip + 1][getAt(mip + 1, childCell.x, childCell.y, childCell.z)].subtreeEntities) {
+                    continue;
+                }
+                if (const RayResult hit = ray.intersects(looseCellBounds(mip + 1, childCell)); hit.hasHit()) {
+                    candidates[count++] = {hit.distance, childCell};
+                }
+            }
+
+            std::sort(candidates, candidates + count, [](const Candidate& a, const Candidate& b) {
+                return a.distance < b.distance;
+            });
+
+            for (int i = 0; i < count; ++i) {
+                if (candidates[i].distance > ray.length) {
+                    return;
+                }
+                const glm::ivec3 childCell = candidates[i].cell;
+
+                for (auto handle : levels[mip + 1][getAt(mip + 1, childCell.x, childCell.y, childCell.z)]) {
+                    raycastEntity(ray, handle, fn);
+                }
+
+                if (mip + 2 < maxLevels) {
+                    raycastCell(ray, mip + 1, childCell, fn);
+                }
+            }
+        }
     public:
-        LocationHandle createEntityHandle(EntryPosition ePosition);
+        LocationHandle createEntityHandle(EntryPosition ePosition, const AABB& worldBox);
 
         Region() = default;
 
         explicit Region(const CreateInfo &info);
 
+        /* builds the mip hierarchy and bins every entity into it, regions are created resident */
+        void makeResident();
+
+        /**
+         * Drops the mip hierarchy but keeps the entity list, so handles stay valid and the region
+         * can still be edited and culled, by testing every entity, until it is made resident again
+         */
+        void evict();
+
+        bool isResident() const { return resident; }
+
+        /* bytes the mip hierarchy takes once resident, excluding cells that spilled to the heap */
+        size_t residentBytes() const;
+
+        unsigned size() const { return entities.liveCount; }
+
         MipPosition getMipPosition(AABB aabb) const;
 
         LocationHandle addEntity(const AABB& worldBox);
@@ -167,50 +368,147 @@ public:
 
         int getAt(int mip, int x, int y, int z) const;
 
+        /* the box tests of a cull, classify narrows planeMask like Frustum::classifyAABB */
+        struct FrustumTester {
+            const Frustum& frustum;
+
+            Frustum::Containment classify(const AABB& box, uint8_t& planeMask) const {
+                return frustum.classifyAABB(box, planeMask);
+            }
+
+            bool isVisible(const AABB& box, const uint8_t planeMask) const {
+                return frustum.isAABBInsideFrustum(box, planeMask);
+            }
+        };
+
+        /* cullWith tests of an overlap query, cells inside box pass their entities untested */
+        struct BoxTester {
+            const AABB& box;
+
+            Frustum::Containment classify(const AABB& cellBox, uint8_t& planeMask) const {
+                if (!box.intersects(cellBox)) {
+                    return Frustum::Containment::OUTSIDE;
+                }
+                if (box.contains(cellBox)) {
+                    planeMask = 0;
+                    return Frustum::Containment::INSIDE;
+                }
+                return Frustum::Containment::INTERSECTS;
+            }
+
+            bool isVisible(const AABB& entityBox, const uint8_t planeMask) const {
+                return !planeMask || box.intersects(entityBox);
+            }
+        };
+
+        /**
+         * Walks the mip hierarchy carrying the mask of planes a cell still straddles,
+         * cells fully inside the frustum pass their entities without further tests.
+         * Mip 0 can hold entities larger than the region, those are tested on their own
+         */
         template <typename Fn>
-        void cull(AABB worldBox, Fn&& fn) {
-            worldBox.center -= position;
-
-            if (isInfinite() || worldBox.contains(bounds())) {
-                for (auto& level : levels) {
-                    for (auto& mip : level) {
-                        for (auto& handle : mip) {
-                            fn(handle);
-                        }
+        void cull(const Frustum& frustum, Fn&& fn) {
+            FrustumTester tester{frustum};
+            cullWith(tester, fn);
+        }
+
+        /* cull with the box tests of tester, see FrustumTester */
+        template <typename Tester, typename Fn>
+        void cullWith(Tester& tester, Fn&& fn) {
+            if (!resident) {
+                entities.forEachLive([&](const LocationHandle handle) {
+                    if (tester.isVisible(entities.bounds(handle), Frustum::ALL_PLANES)) {
+                        fn(handle);
                     }
-                }
+                });
                 return;
             }
 
             for (auto handle : levels[0][0]) {
-                fn(handle);
+                if (tester.isVisible(entities.bounds(handle), Frustum::ALL_PLANES)) {
+                    fn(handle);
+                }
             }
 
-            for (int mip = 1; mip < maxLevels; ++mip) {
-                auto& mipData = levels[mip];
+            if (isInfinite() || maxLevels < 2) {
+                return;
+            }
 
-                const int cellSize = maxSize >> mip;
+            uint8_t planeMask = Frustum::ALL_PLANES;
 
-                glm::ivec3 cellMin = geom::floorDiv3(worldBox.min(), cellSize);
-                glm::ivec3 cellMax = geom::floorDiv3(worldBox.max() - glm::vec3(1e-6f), cellSize);
+            if (tester.classify(looseCellBounds(0, glm::ivec3(0)), planeMask) == Frustum::Containment::OUTSIDE) {
+                return;
+            }
 
-                cellMin = glm::max(cellMin, glm::ivec3(0));
+            for (int child = 0; child < 8; ++child) {
+                const glm::ivec3 cell(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+                cullCell(tester, 1, cell, planeMask, fn);
+            }
+        }
+
+        /**
+         * cull for count views in one walk, fn(LocationHandle, uint32_t viewMask) runs once per entity
+         * any view sees. A cell is only tested by the views that still see its parent
+         */
+        template <typename Fn>
+        void cullViews(const Frustum* frusta, const unsigned count, Fn&& fn) {
+            ViewPlaneMasks masks;
+            masks.active = count == 32 ? ~0u : (1u << count) - 1;
+            std::fill_n(masks.planes, count, Frustum::ALL_PLANES);
+
+            if (!resident) {
+                entities.forEachLive([&](const LocationHandle handle) {
+                    if (const uint32_t visible = visibleViews(frusta, masks, entities.bounds(handle))) {
+                        fn(handle, visible);
+                    }
+                });
+                return;
+            }
+
+            for (auto handle : levels[0][0]) {
+                if (const uint32_t visible = visibleViews(frusta, masks, entities.bounds(handle))) {
+                    fn(handle, visible);
+                }
+            }
+
+            if (isInfinite() || maxLevels < 2) {
+                return;
+            }
 
-                cellMax = glm::min(cellMax, glm::ivec3(maxSize / cellSize) - glm::ivec3(1));
+            classifyViews(frusta, looseCellBounds(0, glm::ivec3(0)), masks);
 
-                for (int z = cellMin.z; z <= cellMax.z; ++z)
-                    for (int y = cellMin.y; y <= cellMax.y; ++y)
-                        for (int x = cellMin.x; x <= cellMax.x; ++x)
-                        {
-                            const int index = getAt(mip, x, y, z);
+            if (!masks.active) {
+                return;
+            }
 
-                            if (mipData[index].localEntities.empty()) continue;
+            for (int child = 0; child < 8; ++child) {
+                const glm::ivec3 cell(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+                cullCellViews(frusta, 1, cell, masks, fn);
+            }
+        }
 
-                            for (auto handle : mipData[index]) {
-                                fn(handle);
-                            }
-                        }
+        /**
+         * fn(LocationHandle, const RayResult&) -> float for every entity whose bounds ray hits, ray.length is
+         * clipped to what fn returns and 0 stops. Cells are walked nearest first and dropped once the ray
+         * ends before them, so a closest hit query touches few cells past the hit
+         */
+        template <typename Fn>
+        void raycast(Ray& ray, Fn&& fn) {
+            if (!resident) {
+                entities.forEachLive([&](const LocationHandle handle) {
+                    raycastEntity(ray, handle, fn);
+                });
+                return;
+            }
+
+            for (auto handle : levels[0][0]) {
+                raycastEntity(ray, handle, fn);
+            }
+
+            if (isInfinite() || maxLevels < 2 || !ray.intersects(looseCellBounds(0, glm::ivec3(0))).hasHit()) {
+                return;
             }
+            raycastCell(ray, 0, glm::ivec3(0), fn);
         }
 
         bool isFinite() const { return !infinite; }
@@ -224,111 +522,284 @@ private:
         Region region;
         std::vector<PrimitiveCollectionID> handles;
         std::vector<unsigned> freeHandles;
+        uint64_t version = 0; // changes whenever an entity is added, moved or removed
     };
-    std::unordered_map<glm::ivec3, RegionCollectionPair, IVec3Hash> regions{};
+    SparsePagedGrid<RegionCollectionPair> regions{};
     int regionHighestSize = 512;
     int regionLowestSize = 16;
 
-    std::vector<PrimitiveCollectionID> infiniteHandles{};
-    std::vector<std::pair<glm::ivec3, Region::LocationHandle>> collectionToHandle{};
+    /* world wide so a region recreated at the same coordinates never repeats a version */
+    uint64_t regionVersions = 0;
+
+    /* coordinates of every region ever created lie within, bounds the region walk of a raycast */
+    glm::ivec3 regionMin{std::numeric_limits<int>::max()};
+    glm::ivec3 regionMax{std::numeric_limits<int>::min()};
+
+    void touch(RegionCollectionPair& region) {
+        region.version = ++regionVersions;
+    }
 public:
-    MipWorld(int regionLowestSize, const int regionHighestSize) : regionHighestSize(regionHighestSize), regionLowestSize(regionLowestSize) {}
+    /**
+     * Cull results of one view from earlier frames. A region's visible list is reused while its content
+     * is unchanged and the view's planes moved less than the distance of every tested box to the planes
+     * it was tested against, so a reused list is exactly what culling the region again would produce
+     */
+    class CullCache {
+        friend class MipWorld;
+
+        struct RegionEntry {
+            uint64_t version = 0;
+            glm::vec4 planes[6]{};
+            float margins[6]{};
+            glm::vec3 origin{};
+            float extent = 0.0f;
+            std::vector<PrimitiveCollectionID> visible;
+            bool used = false;
+
+            /* bound on how far any tested box moved relative to each plane, against the smallest margin */
+            bool isReusable(const Frustum& frustum) const;
+        };
 
-    void onAddCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
-        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
-            infiniteHandles.push_back(id);
-            return;
+        SparsePagedGrid<RegionEntry> entries{};
+
+        std::vector<RegionEntry*> order{};
+        std::vector<std::pair<RegionCollectionPair*, RegionEntry*>> stale{};
+        std::vector<glm::ivec3> unused{};
+
+        size_t reused = 0;
+    public:
+        void clear() {
+            entries = SparsePagedGrid<RegionEntry>();
         }
-        AABB aabb = collection.getWorldBounds();
 
-        glm::ivec3 regionCoords = geom::floorDiv3(aabb.center, regionHighestSize);
+        /* regions of the last cull served from the cache and culled again */
+        size_t getReusedRegions() const { return reused; }
+        size_t getCulledRegions() const { return stale.size(); }
+    };
+private:
+    /* FrustumTester that also records, per plane, the smallest distance of a tested box to flipping its result */
+    struct MarginTester {
+        const Frustum& frustum;
+        glm::vec3 origin{};
+        float margins[6];
+        float extent = 0.0f;
+
+        MarginTester(const Frustum& frustum, const glm::vec3 origin) : frustum(frustum), origin(origin) {
+            std::fill_n(margins, 6, std::numeric_limits<float>::max());
+        }
 
-        const auto it = regions.find(regionCoords);
+        Frustum::Containment classify(const AABB& box, uint8_t& planeMask) {
+            extent = std::max(extent, glm::length(box.center - origin) + glm::length(box.halfSize));
 
-        RegionCollectionPair* region{};
+            for (int i = 0; i < 6; ++i) {
+                const uint8_t bit = static_cast<uint8_t>(1u << i);
 
-        if (it == regions.end()) {
-            region = &regions.emplace(regionCoords,
-                RegionCollectionPair(
-                    Region(CreateInfo(regionCoords * regionHighestSize, regionLowestSize, regionHighestSize, true))
-                )
-            ).first->second;
-        } else {
-            region = &it->second;
-        }
+                if (!(planeMask & bit)) {
+                    continue;
+                }
+                const glm::vec4& plane = frustum.planes[i];
 
-        auto handle = region->region.addEntity(collection.getWorldBounds());
+                const float s = glm::dot(glm::vec3(plane), box.center) + plane.w;
+                const float r = glm::dot(glm::abs(glm::vec3(plane)), box.halfSize);
 
-        if (region->handles.size() <= handle.id()) {
-            region->handles.resize(handle.id() + 64);
-        }
+                if (s + r < 0.0f) {
+                    margins[i] = std::min(margins[i], -(s + r));
+                    return Frustum::Containment::OUTSIDE;
+                }
+                margins[i] = std::min(margins[i], std::min(s + r, std::abs(s - r)));
 
-        region->handles[handle.id()] = id;
+                if (s - r >= 0.0f) {
+                    planeMask &= ~bit;
+                }
+            }
+            return planeMask ? Frustum::Containment::INTERSECTS : Frustum::Containment::INSIDE;
+        }
 
-        if (collectionToHandle.size() <= id.id()) {
-            collectionToHandle.resize(id.id() + 512);
+        bool isVisible(const AABB& box, uint8_t planeMask) {
+            return classify(box, planeMask) != Frustum::Containment::OUTSIDE;
         }
+    };
 
-        collectionToHandle[id.id()] = { regionCoords, handle };
-    }
+    void cullRegionCached(const Frustum& frustum, RegionCollectionPair& region, CullCache::RegionEntry& entry) const;
+
+    struct CollectionLocation {
+        constexpr static unsigned NO_MIGRATION = std::numeric_limits<unsigned>::max();
 
-    void onUpdateCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange &change) {
-        if (change.isTransformChanged()) {
+        glm::ivec3 region{};
+        Region::LocationHandle handle{};
+        unsigned pendingMigration = NO_MIGRATION;
+    };
+
+    /* a collection whose bounds left its region, applied in one batch by flushMigrations */
+    struct Migration {
+        PrimitiveCollectionID id{};
+        glm::ivec3 from{};
+        glm::ivec3 to{};
+        AABB bounds{};
+        bool cancelled = false;
+    };
+
+    std::vector<PrimitiveCollectionID> infiniteHandles{};
+    std::vector<CollectionLocation> collectionToHandle{};
+    std::vector<Migration> pendingMigrations{};
+
+    struct ThreadCullList;
+
+    /* the visible collections of cullRegions[order] are [first, last) of the list of the thread that culled it */
+    struct CullSpan {
+        unsigned order = 0;
+        const ThreadCullList* list = nullptr;
+        unsigned first = 0;
+        unsigned last = 0;
+    };
+
+    /* viewMasks runs parallel to visible for multi-view culls and stays empty otherwise */
+    struct ThreadCullList {
+        std::vector<PrimitiveCollectionID> visible;
+        std::vector<uint32_t> viewMasks;
+        std::vector<CullSpan> spans;
+    };
+
+    /* regions per task, below this many candidate regions culling stays on the calling thread */
+    constexpr static size_t PARALLEL_CULL_GRAIN = 2;
+    constexpr static size_t PARALLEL_CULL_MIN_REGIONS = 8;
+
+    /* what one query culls into, owned by the call so queries may run on several threads or nest in callbacks */
+    struct CullScratch {
+        std::vector<RegionCollectionPair*> regions;
+        tbb::enumerable_thread_specific<ThreadCullList> lists;
+        std::vector<CullSpan> spans;
+    };
 
+    /* scratches of one thread, [0, depth) belong to the queries currently nested on it */
+    struct CullScratchStack {
+        std::vector<std::unique_ptr<CullScratch>> scratches;
+        size_t depth = 0;
+    };
+
+    /* takes the next free scratch of the calling thread and hands it back when the query returns */
+    class ScopedCullScratch {
+        CullScratchStack& stack;
+        CullScratch* scratch;
+    public:
+        explicit ScopedCullScratch(CullScratchStack& stack) : stack(stack) {
+            if (stack.depth == stack.scratches.size()) {
+                stack.scratches.push_back(std::make_unique<CullScratch>());
+            }
+            scratch = stack.scratches[stack.depth++].get();
+            scratch->regions.clear();
         }
-    }
 
-    void onRemoveCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
-        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
-            auto it = std::find(infiniteHandles.begin(), infiniteHandles.end(), id);
-            infiniteHandles.erase(it);
-            return;
+        ~ScopedCullScratch() {
+            --stack.depth;
         }
 
-        auto [regionCoords, spatialHandle] = collectionToHandle[id.id()];
+        ScopedCullScratch(const ScopedCullScratch&) = delete;
+        ScopedCullScratch& operator=(const ScopedCullScratch&) = delete;
+
+        CullScratch& operator*() const { return *scratch; }
+        CullScratch* operator->() const { return scratch; }
+    };
+
+    tbb::enumerable_thread_specific<CullScratchStack> cullScratch{};
 
-        auto regionIt = regions.find(regionCoords);
+    void cullRegion(const Frustum& frustum, RegionCollectionPair& region, ThreadCullList& out) const;
 
-        auto& [region, handles, freelist] = regionIt->second;
+    void cullRegionViews(const Frustum* frusta, unsigned count, RegionCollectionPair& region, ThreadCullList& out) const;
 
-        region.removeEntity(spatialHandle);
-        freelist.push_back(spatialHandle.id());
+    /* appends the regions that may hold entities overlapping frustum to out */
+    void gatherRegions(const Frustum& frustum, std::vector<RegionCollectionPair*>& out);
+
+    void gatherRegions(const AABB& box, std::vector<RegionCollectionPair*>& out);
+
+    /* runs cullFn(region, list) over scratch.regions, then emitFn(list, first, last) in region order on the calling thread */
+    template <typename CullFn, typename EmitFn>
+    void cullGathered(CullScratch& scratch, CullFn&& cullFn, EmitFn&& emitFn);
+
+    glm::ivec3 regionOf(const AABB& bounds) const {
+        return geom::floorDiv3(bounds.center, regionHighestSize);
     }
 
-    void onCull(const Frustum& frustum, const WorldCullCallback callback) {
-        AABB frustumAABB = frustum.asAABB();
+    RegionCollectionPair& findOrCreateRegion(glm::ivec3 regionCoords);
 
-        glm::ivec3 min = geom::floorDiv3(frustumAABB.min(), regionHighestSize);
-        glm::ivec3 max = geom::floorDiv3(frustumAABB.max() - glm::vec3(1e-6f), regionHighestSize);
+    void insertIntoRegion(RegionCollectionPair& region, glm::ivec3 regionCoords, PrimitiveCollectionID id, const AABB& bounds);
 
-        for (auto inf : infiniteHandles) {
-            callback(inf);
-        }
+    void eraseFromRegion(PrimitiveCollectionID id);
 
-        for (int z = min.z; z <= max.z; ++z) {
-            for (int y = min.y; y <= max.y; ++y) {
-                for (int x = min.x; x <= max.x; ++x) {
-                    const auto regionIt = regions.find(glm::ivec3(x, y, z));
+    /* returns an emptied region's slot to the grid, its pages are freed once they hold no region */
+    void releaseRegionIfEmpty(glm::ivec3 regionCoords);
 
-                    if (regionIt == regions.end()) {
-                        continue;
-                    }
+    void queueMigration(PrimitiveCollectionID id, glm::ivec3 to, const AABB& bounds);
 
-                    AABB regionAABB = regionIt->second.region.bounds();
+    void cancelMigration(PrimitiveCollectionID id);
+public:
+    MipWorld(int regionLowestSize, const int regionHighestSize) : regionHighestSize(regionHighestSize), regionLowestSize(regionLowestSize) {}
 
-                    if (!frustum.isAABBInsideFrustum(regionAABB)) {
-                        continue;
-                    }
+    void onAddCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
+        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
+            infiniteHandles.push_back(id);
+            return;
+        }
+        const AABB bounds = collection.getWorldBounds();
+        const glm::ivec3 regionCoords = regionOf(bounds);
 
-                    auto& [region, handles, freelist] = regionIt->second;
+        insertIntoRegion(findOrCreateRegion(regionCoords), regionCoords, id, bounds);
+    }
 
-                    region.cull(frustumAABB, [&](const Region::LocationHandle& handle) {
-                        auto collectionID = handles[handle.id()];
+    /**
+     * Movers that stay inside their region are re-binned right away, and only when they cross a cell.
+     * Movers that leave it are queued and migrated in one batch by the next onSynchronize,
+     * until then queries still find them in their old region
+     */
+    void onUpdateCollection(PrimitiveCollectionID id, const PrimitiveCollection& collection, const PrimitiveCollectionChange &change);
 
-                        callback(collectionID);
-                    });
-                }
-            }
+    void onRemoveCollection(const PrimitiveCollectionID id, const PrimitiveCollection& collection) {
+        if (collection.hasFlag(PrimitiveCollectionFlags::INFINITE_BOUNDS)) {
+            auto it = std::find(infiniteHandles.begin(), infiniteHandles.end(), id);
+            infiniteHandles.erase(it);
+            return;
         }
+        cancelMigration(id);
+        eraseFromRegion(id);
+    }
+
+    /**
+     * Keeps the mip hierarchies of regions near any focus point resident, nearest first,
+     * while their total stays within memoryBudget bytes. Every other region is evicted
+     * and culls its entities linearly until a later call brings it back
+     */
+    void updateResidency(std::span<const glm::vec3> focusPoints, float radius, size_t memoryBudget);
+
+    /* applies queued region changes, sorted so each source and destination region is looked up once */
+    void flushMigrations();
+
+    /* frame sync, the only place queued migrations are applied so queries never change the regions they walk */
+    void onSynchronize() {
+        flushMigrations();
     }
+
+    /**
+     * Queries only read the regions and may run concurrently with each other and from inside their callbacks,
+     * but not alongside collection changes or onSynchronize.
+     * Candidate regions are culled on the TBB pool into per-thread lists,
+     * the callback then runs on the calling thread in region order so the output is deterministic
+     */
+    void onCull(const Frustum& frustum, WorldCullCallback callback);
+
+    /* onCull that reuses the regions of cache still valid for frustum and culls the rest again */
+    void onCull(const Frustum& frustum, WorldCullCallback callback, CullCache& cache);
+
+    /**
+     * Culls every view in one pass over the union of their candidate regions,
+     * each cell is classified only against the views that still see its parent
+     */
+    void onCullViews(const Frustum* frusta, unsigned count, WorldMultiCullCallback callback);
+
+    /**
+     * Steps through the regions along the ray with a 3D-DDA, nearest first, and walks the cells of each
+     * nearest first. The walk ends once the ray, clipped by the callback, ends before the next region
+     */
+    void onRaycast(const Ray& ray, WorldRayCallback callback);
+
+    void onOverlap(const AABB& box, WorldCullCallback callback);
 };
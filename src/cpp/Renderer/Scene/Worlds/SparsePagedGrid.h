@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+#include <constexpr/assert.h>
+
+/**
+ * Unbounded sparse 3D grid, cells are grouped into pages of (1 << PageBits)^3 slots.
+ * A lookup is one probe into an open addressed page directory and one slot read,
+ * values live in a pooled deque so their addresses stay stable and freed slots are reused.
+ * Pages are released once their last cell is erased, memory follows occupancy rather than extent
+ */
+template <typename T, int PageBits = 3>
+class SparsePagedGrid {
+public:
+    constexpr static int PAGE_SIZE = 1 << PageBits;
+    constexpr static int PAGE_CELLS = PAGE_SIZE * PAGE_SIZE * PAGE_SIZE;
+    constexpr static unsigned INVALID = ~0u;
+private:
+    struct Page {
+        glm::ivec3 coords{};
+        unsigned occupied = 0;
+        unsigned slots[PAGE_CELLS];
+
+        Page() {
+            std::fill(std::begin(slots), std::end(slots), INVALID);
+        }
+    };
+
+    struct Entry {
+        glm::ivec3 coords{};
+        std::optional<T> value{};
+    };
+
+    struct DirectoryEntry {
+        glm::ivec3 coords{};
+        unsigned page = INVALID;
+    };
+
+    std::vector<DirectoryEntry> directory = std::vector<DirectoryEntry>(64);
+    size_t directoryUsed = 0;
+
+    std::deque<Page> pages{};
+    std::vector<unsigned> freePages{};
+
+    std::deque<Entry> pool{};
+    std::vector<unsigned> freeEntries{};
+    size_t count = 0;
+
+    static glm::ivec3 pageOf(const glm::ivec3 cell) {
+        return cell >> PageBits;
+    }
+
+    static unsigned slotOf(const glm::ivec3 cell) {
+        const glm::ivec3 local = cell & (PAGE_SIZE - 1);
+        return local.x + (local.y << PageBits) + (local.z << (2 * PageBits));
+    }
+
+    static size_t hash(const glm::ivec3 page) {
+        const auto x = static_cast<uint32_t>(page.x) * 73856093u;
+        const auto y = static_cast<uint32_t>(page.y) * 19349663u;
+        const auto z = static_cast<uint32_t>(page.z) * 83492791u;
+        return x ^ y ^ z;
+    }
+
+    size_t probe(const glm::ivec3 page) const {
+        const size_t mask = directory.size() - 1;
+        size_t at = hash(page) & mask;
+
+        while (directory[at].page != INVALID && directory[at].coords != page) {
+            at = (at + 1) & mask;
+        }
+        return at;
+    }
+
+    void growDirectory() {
+        std::vector<DirectoryEntry> old = std::move(directory);
+        directory = std::vector<DirectoryEntry>(old.size() * 2);
+
+        for (auto& entry : old) {
+            if (entry.page != INVALID) {
+                directory[probe(entry.coords)] = entry;
+            }
+        }
+    }
+
+    Page* findPage(const glm::ivec3 page) {
+        const auto& entry = directory[probe(page)];
+        return entry.page == INVALID ? nullptr : &pages[entry.page];
+    }
+
+    const Page* findPage(const glm::ivec3 page) const {
+        const auto& entry = directory[probe(page)];
+        return entry.page == INVALID ? nullptr : &pages[entry.page];
+    }
+
+    Page& findOrCreatePage(const glm::ivec3 page) {
+        if (Page* existing = findPage(page)) {
+            return *existing;
+        }
+
+        if ((directoryUsed + 1) * 2 > directory.size()) {
+            growDirectory();
+        }
+
+        unsigned index;
+        if (!freePages.empty()) {
+            index = freePages.back();
+            freePages.pop_back();
+            pages[index] = Page();
+        } else {
+            index = static_cast<unsigned>(pages.size());
+            pages.emplace_back();
+        }
+        pages[index].coords = page;
+
+        directory[probe(page)] = {page, index};
+        ++directoryUsed;
+        return pages[index];
+    }
+
+    /* backward shift deletion, keeps probe chains intact without tombstones */
+    void erasePage(const glm::ivec3 page) {
+        const size_t mask = directory.size() - 1;
+        size_t hole = probe(page);
+
+        freePages.push_back(directory[hole].page);
+        directory[hole] = {};
+        --directoryUsed;
+
+        for (size_t at = (hole + 1) & mask; directory[at].page != INVALID; at = (at + 1) & mask) {
+            const size_t home = hash(directory[at].coords) & mask;
+
+            // entry stays if its home lies cyclically in (hole, at]
+            const bool reachable = hole <= at ? (home > hole && home <= at) : (home > hole || home <= at);
+            if (reachable) {
+                continue;
+            }
+            directory[hole] = directory[at];
+            directory[at] = {};
+            hole = at;
+        }
+    }
+public:
+    SparsePagedGrid() = default;
+
+    SparsePagedGrid(const SparsePagedGrid&) = delete;
+    SparsePagedGrid& operator = (const SparsePagedGrid&) = delete;
+
+    SparsePagedGrid(SparsePagedGrid&&) noexcept = default;
+    SparsePagedGrid& operator = (SparsePagedGrid&&) noexcept = default;
+
+    T* find(const glm::ivec3 cell) {
+        const Page* page = findPage(pageOf(cell));
+        if (!page) return nullptr;
+
+        const unsigned slot = page->slots[slotOf(cell)];
+        return slot == INVALID ? nullptr : &*pool[slot].value;
+    }
+
+    const T* find(const glm::ivec3 cell) const {
+        return const_cast<SparsePagedGrid*>(this)->find(cell);
+    }
+
+    template <typename CreateFn>
+    T& findOrCreate(const glm::ivec3 cell, CreateFn&& create) {
+        Page& page = findOrCreatePage(pageOf(cell));
+        unsigned& slot = page.slots[slotOf(cell)];
+
+        if (slot != INVALID) {
+            return *pool[slot].value;
+        }
+
+        if (!freeEntries.empty()) {
+            slot = freeEntries.back();
+            freeEntries.pop_back();
+        } else {
+            slot = static_cast<unsigned>(pool.size());
+            pool.emplace_back();
+        }
+
+        auto& entry = pool[slot];
+        entry.coords = cell;
+        entry.value.emplace(create());
+
+        ++page.occupied;
+        ++count;
+        return *entry.value;
+    }
+
+    void erase(const glm::ivec3 cell) {
+        Page* page = findPage(pageOf(cell));
+        cexpr::require(page);
+
+        unsigned& slot = page->slots[slotOf(cell)];
+        cexpr::require(slot != INVALID);
+
+        pool[slot].value.reset();
+        freeEntries.push_back(slot);
+        slot = INVALID;
+        --count;
+
+        if (--page->occupied == 0) {
+            erasePage(pageOf(cell));
+        }
+    }
+
+    /* fn(glm::ivec3 cell, T& value), in pool order */
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        for (auto& entry : pool) {
+            if (entry.value) {
+                fn(entry.coords, *entry.value);
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    size_t memoryBytes() const {
+        return directory.capacity() * sizeof(DirectoryEntry) + pages.size() * sizeof(Page) + pool.size() * sizeof(Entry);
+    }
+};
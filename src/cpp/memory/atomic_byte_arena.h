@@ -1,6 +1,9 @@
 #pragma once
 #include <atomic>
+#include <algorithm>
+#include <constexpr/assert.h>
 #include "type_info.h"
+#include "telemetry.h"
 
 namespace mem {
     template <typename T>
@@ -108,6 +111,11 @@ namespace mem {
         size_t capacity() const {
             return myCapacity;
         }
+
+        allocator_usage usage() const {
+            const size_t used = std::min(next(), myCapacity);
+            return {used, myCapacity, myData != nullptr, myCapacity - used};
+        }
     };
 
     struct atomic_byte_arena_traits_default {
@@ -122,7 +130,166 @@ namespace mem {
 
     using atomic_byte_arena = atomic_byte_arena_traits<atomic_byte_arena_traits_default>;
 
-    struct chained_atomic_byte_arena {
-        tbb::concurrent_vector<atomic_byte_arena> arenas;
+    /**
+     * Lock-free growable atomic_byte_arena.
+     * When the current block is exhausted a successor of at least double the capacity
+     * is CAS-installed, the losing thread frees its block and continues in the winner's,
+     * so allocate never fails and never blocks.
+     * reset keeps the whole chain for reuse and must not race allocate
+     */
+    template <IsAtomicByteArena Impl>
+    class chained_atomic_byte_arena_traits {
+        struct block {
+            atomic_byte_arena_traits<Impl> arena;
+            std::atomic<block*> successor = nullptr;
+
+            explicit block(const size_t capacity) : arena(capacity) {}
+        };
+
+        block* head = nullptr;
+        std::atomic<block*> current = nullptr;
+
+        block* successor_of(block* at, const size_t bytes, const size_t align) {
+            block* next = at->successor.load(std::memory_order_acquire);
+            if (next) {
+                return next;
+            }
+
+            const size_t capacity = std::max(at->arena.capacity() * 2, bytes + align);
+            auto* created = new block(capacity);
+
+            if (at->successor.compare_exchange_strong(next, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return created;
+            }
+            delete created;
+            return next;
+        }
+
+        void destroy_chain() {
+            block* at = head;
+            while (at) {
+                block* next = at->successor.load(std::memory_order_relaxed);
+                delete at;
+                at = next;
+            }
+            head = nullptr;
+            current.store(nullptr, std::memory_order_relaxed);
+        }
+
+        template <typename Fn>
+        void for_each_block(Fn&& fn) const {
+            for (const block* at = head; at; at = at->successor.load(std::memory_order_acquire)) {
+                fn(at->arena);
+            }
+        }
+    public:
+        chained_atomic_byte_arena_traits() = default;
+
+        template <CastableToUll Capacity>
+        explicit chained_atomic_byte_arena_traits(const Capacity capacity) : head(new block(static_cast<size_t>(capacity))), current(head) {}
+
+        chained_atomic_byte_arena_traits(const chained_atomic_byte_arena_traits&) = delete;
+        chained_atomic_byte_arena_traits& operator=(const chained_atomic_byte_arena_traits&) = delete;
+
+        chained_atomic_byte_arena_traits(chained_atomic_byte_arena_traits&& other) noexcept : head(other.head), current(other.current.load()) {
+            other.head = nullptr;
+            other.current = nullptr;
+        }
+
+        chained_atomic_byte_arena_traits& operator=(chained_atomic_byte_arena_traits&& other) noexcept {
+            if (this != &other) {
+                destroy_chain();
+                head = other.head;
+                current = other.current.load();
+
+                other.head = nullptr;
+                other.current = nullptr;
+            }
+            return *this;
+        }
+
+        ~chained_atomic_byte_arena_traits() {
+            destroy_chain();
+        }
+
+        void* allocate(const size_t bytes, const size_t align) {
+            cexpr::require(head != nullptr);
+            block* at = current.load(std::memory_order_acquire);
+
+            while (true) {
+                if (void* ptr = at->arena.allocate(bytes, align)) {
+                    return ptr;
+                }
+
+                block* next = successor_of(at, bytes, align);
+                /* another thread may have advanced past us already, continue from wherever current is */
+                at = current.compare_exchange_strong(at, next, std::memory_order_acq_rel, std::memory_order_acquire) ? next : at;
+            }
+        }
+
+        void* allocate(const type_info* type, const size_t count, const size_t aligned = -1) {
+            return allocate(type->size * count, aligned != -1 ? aligned : type->align);
+        }
+
+        /* rewinds every block, the chain is kept so the next frame does not grow again */
+        void reset() {
+            for (block* at = head; at; at = at->successor.load(std::memory_order_relaxed)) {
+                at->arena.reset();
+            }
+            current.store(head, std::memory_order_release);
+        }
+
+        /* replaces the chain with a single block large enough for everything it held */
+        void reset_compact() {
+            const size_t total = capacity();
+            if (!head || !head->successor.load(std::memory_order_relaxed)) {
+                reset();
+                return;
+            }
+            destroy_chain();
+            head = new block(total);
+            current.store(head, std::memory_order_release);
+        }
+
+        /* like byte_arena::reset_presized, leaves a single block of at least bytes and at most twice as large */
+        void reset_presized(const size_t bytes) {
+            if (head && !head->successor.load(std::memory_order_relaxed)) {
+                const size_t capacity = head->arena.capacity();
+
+                if (capacity >= bytes && capacity <= bytes * 2) {
+                    reset();
+                    return;
+                }
+            }
+            destroy_chain();
+            head = new block(bytes);
+            current.store(head, std::memory_order_release);
+        }
+
+        size_t bytes_used() const {
+            size_t used = 0;
+            for_each_block([&](auto& arena) { used += std::min(arena.next(), arena.capacity()); });
+            return used;
+        }
+
+        size_t capacity() const {
+            size_t total = 0;
+            for_each_block([&](auto& arena) { total += arena.capacity(); });
+            return total;
+        }
+
+        size_t block_count() const {
+            size_t count = 0;
+            for_each_block([&](auto&) { ++count; });
+            return count;
+        }
+
+        allocator_usage usage() const {
+            allocator_usage usage;
+            for_each_block([&](auto& arena) { usage += arena.usage(); });
+            return usage;
+        }
     };
+
+    using chained_atomic_byte_arena = chained_atomic_byte_arena_traits<atomic_byte_arena_traits_default>;
 }
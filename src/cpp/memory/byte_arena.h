@@ -4,6 +4,7 @@
 #include "TypeOps.h"
 #include "alloc.h"
 #include "memory/memory.h"
+#include "telemetry.h"
 
 namespace mem {
     class bytes_required {
@@ -48,6 +49,37 @@ namespace mem {
     template <typename T, typename Arena>
     struct byte_arena_adaptor;
 
+    /**
+     * Decaying high-water mark of per-frame arena usage.
+     * Follows a spike immediately and decays by `decay` every frame after it,
+     * target() is the single block size the next frame should start with
+     */
+    class high_water_mark {
+        double mark = 0.0;
+        double decay = 0.9;
+        double headroom = 1.25;
+        size_t minimum = 0;
+    public:
+        high_water_mark() = default;
+
+        explicit high_water_mark(const size_t minimum, const double decay = 0.9, const double headroom = 1.25)
+        : decay(decay), headroom(headroom), minimum(minimum) {}
+
+        size_t sample(const size_t bytesUsed) {
+            mark = std::max(static_cast<double>(bytesUsed), mark * decay);
+            return target();
+        }
+
+        size_t target() const {
+            const auto bytes = static_cast<size_t>(mark * headroom);
+            return round_up_to_64(std::max(bytes, minimum));
+        }
+
+        size_t peak() const {
+            return static_cast<size_t>(mark);
+        }
+    };
+
     template <
         typename ReallocSchema = same_alloc_schema,
         size_t BaseAlign = alignof(std::max_align_t)
@@ -248,10 +280,25 @@ namespace mem {
                 deallocate();
                 destroy_adjacent();
                 memory = allocate_mem(totalCapacity);
+                capacity_ = totalCapacity;
             }
             next = 0;
         }
 
+        /**
+         * Resets into a single block of `bytes`, the current block is kept while it fits
+         * and is at most twice as large so steady frames never reallocate.
+         * This function invalidates any memory handed by this instance
+         */
+        void reset_presized(const size_t bytes) {
+            destroy_adjacent();
+            next = 0;
+
+            if (capacity_ < bytes || capacity_ > bytes * 2) {
+                initialize(bytes);
+            }
+        }
+
         /**
          * This function invalidates any memory handed by this instance
          */
@@ -306,6 +353,28 @@ namespace mem {
             return cap;
         }
 
+        size_t block_count() const {
+            size_t blocks = 0;
+            for (auto self = this; self; self = self->nextArena) {
+                blocks += self->memory != nullptr;
+            }
+            return blocks;
+        }
+
+        allocator_usage usage() const {
+            allocator_usage usage;
+
+            for (auto self = this; self; self = self->nextArena) {
+                if (!self->memory) continue;
+
+                usage.bytesUsed += self->next;
+                usage.capacityBytes += self->capacity_;
+                usage.largestFreeBlock = std::max(usage.largestFreeBlock, self->capacity_ - self->next);
+                ++usage.blocks;
+            }
+            return usage;
+        }
+
         char* data() const {
             return memory;
         }
@@ -3,6 +3,7 @@
 #include <map>
 #include "type_info.h"
 #include "alloc.h"
+#include "telemetry.h"
 
 namespace mem {
     class piece_list {
@@ -76,6 +77,14 @@ namespace mem {
             }
             return remaining;
         }
+
+        size_t largest() const {
+            size_t largest = 0;
+            for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+                largest = std::max(largest, it->second);
+            }
+            return largest;
+        }
     };
 
     class free_list_allocator_traits {
@@ -154,6 +163,11 @@ namespace mem {
             return capacity;
         }
 
+        allocator_usage usage() const {
+            const size_t free = freeBlocks.remaining();
+            return {capacity - free, capacity, memory != nullptr, freeBlocks.largest()};
+        }
+
         char* data() const {
             return memory;
         }
@@ -233,6 +247,14 @@ namespace mem {
             allocators.emplace_back(allocate_memory(totalCapacity), totalCapacity, alignment);
         }
 
+        allocator_usage usage() const {
+            allocator_usage usage;
+            for (auto& allocator : allocators) {
+                usage += allocator.usage();
+            }
+            return usage;
+        }
+
         bool does_pointer_belong_here(void* start) const {
             for (auto& allocator : allocators) {
                 if (allocator.does_pointer_belong_here(start)) {
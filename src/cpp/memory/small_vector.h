@@ -0,0 +1,361 @@
+#pragma once
+#include <type_traits>
+#include <new>
+#include <constexpr/assert.h>
+#include "alloc.h"
+#include "vector.h"
+
+namespace mem {
+    /**
+     * mem::vector with inline storage for the first N elements.
+     * Alloc is only touched once the inline capacity is exceeded,
+     * so any adaptor usable with mem::vector (byte_arena_adaptor, free_list_adaptor, FrameAllocatorAdaptor)
+     * can back the overflow
+     */
+    template <
+        typename T,
+        size_t N,
+        typename Alloc = default_allocator<T>,
+        typename ReallocationSchema = doubling_schema,
+        typename size_type = size_t
+    > requires IsAllocator<T, Alloc> && (N > 0)
+    class small_vector {
+    public:
+        using value_type = T;
+        using alloc_traits = allocator_traits<Alloc>;
+        using allocator_type = Alloc;
+        using iterator = vector_iterator<T>;
+
+        static constexpr size_type inline_capacity = static_cast<size_type>(N);
+    private:
+        alignas(T) char storage[sizeof(T) * N];
+        T* ptr = reinterpret_cast<T*>(storage);
+        size_type current = 0;
+        size_type max = inline_capacity;
+        Alloc allocator;
+        ReallocationSchema reallocSchema;
+
+        T* inline_data() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+
+        const T* inline_data() const {
+            return std::launder(reinterpret_cast<const T*>(storage));
+        }
+
+        template <typename... Args>
+        T* construct(T* at, Args&&... args) {
+            return allocator.construct(at, std::forward<Args>(args)...);
+        }
+
+        void destroy(const size_type index) {
+            allocator.destroy(ptr + index);
+        }
+
+        void destroy_all() {
+            for (size_type i = 0; i < current; ++i) {
+                destroy(i);
+            }
+        }
+
+        void deallocate() {
+            if (!is_inline()) {
+                allocator.deallocate(ptr, max);
+            }
+        }
+
+        /* moves the live elements into dst, leaving ptr with destroyed storage */
+        void relocate(T* dst) {
+            for (size_type i = 0; i < current; ++i) {
+                construct(dst + i, std::move(ptr[i]));
+                destroy(i);
+            }
+        }
+
+        void realloc(const size_type newCapacity) {
+            cexpr::require(newCapacity >= current);
+
+            T* newPtr = newCapacity <= inline_capacity ? inline_data() : allocator.allocate(newCapacity);
+
+            if (newPtr == ptr) {
+                return;
+            }
+            relocate(newPtr);
+            deallocate();
+
+            ptr = newPtr;
+            max = newPtr == inline_data() ? inline_capacity : newCapacity;
+        }
+
+        void ensure_has_memory(const size_type required) {
+            if (current + required > max) [[unlikely]] {
+                realloc(static_cast<size_type>(reallocSchema.grow(max, required)));
+            }
+        }
+
+        size_type index_of(const T* at) const {
+            cexpr::require(at >= ptr && at <= ptr + current);
+            return static_cast<size_type>(at - ptr);
+        }
+
+        size_type index_of(const size_type index) const {
+            cexpr::require(index <= current);
+            return index;
+        }
+
+        size_type index_of(const vector_iterator<T>& it) const {
+            return index_of(it.data());
+        }
+
+        size_type index_of(const vector_iterator<const T>& it) const {
+            return index_of(it.data());
+        }
+
+        void steal(small_vector& other) {
+            if (other.is_inline()) {
+                ptr = inline_data();
+                max = inline_capacity;
+
+                for (size_type i = 0; i < other.current; ++i) {
+                    construct(ptr + i, std::move(other.ptr[i]));
+                    other.destroy(i);
+                }
+                current = other.current;
+            } else {
+                ptr = other.ptr;
+                current = other.current;
+                max = other.max;
+            }
+            other.ptr = other.inline_data();
+            other.current = 0;
+            other.max = inline_capacity;
+        }
+    public:
+        small_vector() = default;
+
+        template <typename TAlloc>
+        requires std::constructible_from<Alloc, TAlloc>
+        small_vector(TAlloc&& allocator, const size_t capacity = 0) : allocator(std::forward<TAlloc>(allocator)) {
+            if (capacity) {
+                reserve(static_cast<size_type>(capacity));
+            }
+        }
+
+        small_vector(std::initializer_list<T> items) {
+            reserve(static_cast<size_type>(items.size()));
+            for (auto& item : items) {
+                construct(ptr + current++, item);
+            }
+        }
+
+        small_vector(const small_vector&) = delete;
+        small_vector& operator = (const small_vector&) = delete;
+
+        small_vector(small_vector&& other) noexcept : reallocSchema(std::move(other.reallocSchema)) {
+            if constexpr (alloc_traits::is_always_equal::value) {
+                allocator = other.allocator;
+            } else if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                allocator = std::move(other.allocator);
+            } else {
+                static_assert(false, "Allocator Does not support move semantics");
+            }
+            steal(other);
+        }
+
+        small_vector& operator = (small_vector&& other) noexcept {
+            if (this != &other) {
+                release();
+
+                if constexpr (alloc_traits::is_always_equal::value) {
+                    allocator = other.allocator;
+                } else if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                    allocator = std::move(other.allocator);
+                } else {
+                    static_assert(false, "Allocator Does not support move semantics");
+                }
+                reallocSchema = std::move(other.reallocSchema);
+                steal(other);
+            }
+            return *this;
+        }
+
+        ~small_vector() {
+            destroy_all();
+            deallocate();
+        }
+
+        template <typename TT>
+        requires std::constructible_from<T, TT>
+        T& push_back(TT&& val) {
+            return emplace_back(std::forward<TT>(val));
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            ensure_has_memory(1);
+            return *construct(ptr + current++, std::forward<Args>(args)...);
+        }
+
+        template <typename Index, typename TT>
+        requires std::constructible_from<T, TT>
+        T& insert(Index&& idx, TT&& value) {
+            const size_type index = index_of(idx);
+            ensure_has_memory(1);
+
+            for (size_type i = current; i > index; --i) {
+                construct(ptr + i, std::move(ptr[i - 1]));
+                destroy(i - 1);
+            }
+            ++current;
+            return *construct(ptr + index, std::forward<TT>(value));
+        }
+
+        template <typename Index>
+        auto erase(const Index idx) {
+            const size_type index = index_of(idx);
+            cexpr::require(index < current);
+
+            for (size_type i = index; i + 1 < current; ++i) {
+                destroy(i);
+                construct(ptr + i, std::move(ptr[i + 1]));
+            }
+            destroy(--current);
+            return iterator{ptr + index};
+        }
+
+        /* O(1) erase, the last element takes the place of the erased one */
+        template <typename Index>
+        void swap_erase(const Index idx) {
+            const size_type index = index_of(idx);
+            cexpr::require(index < current);
+
+            if (index != current - 1) {
+                destroy(index);
+                construct(ptr + index, std::move(ptr[current - 1]));
+            }
+            destroy(--current);
+        }
+
+        void pop_back() {
+            cexpr::require(current > 0);
+            destroy(--current);
+        }
+
+        T pop_retrieve() {
+            cexpr::require(current > 0);
+            T temp = std::move(ptr[--current]);
+            destroy(current);
+            return temp;
+        }
+
+        void reserve(const size_type capacity) {
+            if (max < capacity) {
+                realloc(capacity);
+            }
+        }
+
+        /* moves the elements back into the inline buffer when they fit */
+        void shrink_to_fit() {
+            if (!is_inline() && current < max) {
+                realloc(current);
+            }
+        }
+
+        void clear() {
+            destroy_all();
+            current = 0;
+        }
+
+        void release() {
+            clear();
+            deallocate();
+            ptr = inline_data();
+            max = inline_capacity;
+        }
+
+        decltype(auto) operator [] (this auto&& self, const size_type index) {
+            cexpr::require(index < self.current, [&] {
+                using VecT = std::remove_reference_t<decltype(self)>;
+                std::cout << "[" << cexpr::name_of<VecT>
+                          << "] Index out of bounds: index " << index
+                          << " >= size " << self.current
+                          << " (capacity " << self.max
+                          << ")\n";
+            });
+            return std::forward_like<decltype(self)>(self.ptr[index]);
+        }
+
+        template <typename UVal>
+        T* find(const UVal& value) {
+            for (auto& val : *this) {
+                if (val == value) {
+                    return &val;
+                }
+            }
+            return nullptr;
+        }
+
+        template <typename UVal, typename Proj>
+        T* find(const UVal& value, Proj&& proj) {
+            for (auto& val : *this) {
+                if (std::invoke(proj, val) == value) {
+                    return &val;
+                }
+            }
+            return nullptr;
+        }
+
+        operator range<T>() {
+            return {ptr, ptr + current};
+        }
+
+        operator range<const T>() const {
+            return {ptr, ptr + current};
+        }
+
+        T* data() { return ptr; }
+        const T* data() const { return ptr; }
+
+        vector_iterator<T> begin() { return {ptr}; }
+        vector_iterator<T> end() { return {ptr + current}; }
+
+        vector_iterator<const T> begin() const { return {ptr}; }
+        vector_iterator<const T> end() const { return {ptr + current}; }
+
+        auto& front() {
+            cexpr::require(current > 0);
+            return ptr[0];
+        }
+
+        auto& front() const {
+            cexpr::require(current > 0);
+            return ptr[0];
+        }
+
+        auto& back() {
+            cexpr::require(current > 0);
+            return ptr[current - 1];
+        }
+
+        auto& back() const {
+            cexpr::require(current > 0);
+            return ptr[current - 1];
+        }
+
+        size_type size() const { return current; }
+        size_type capacity() const { return max; }
+        bool empty() const { return !current; }
+        bool full() const { return current == max; }
+
+        bool is_inline() const {
+            return ptr == inline_data();
+        }
+
+        const Alloc& get_allocator() const {
+            return allocator;
+        }
+    };
+
+    template <typename T, size_t N, template <typename> typename Alloc, typename Realloc = mem::doubling_schema, typename Size = size_t>
+    using tsmall_vector = small_vector<T, N, Alloc<T>, Realloc, Size>;
+}
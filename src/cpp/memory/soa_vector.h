@@ -0,0 +1,318 @@
+#pragma once
+#include <initializer_list>
+#include <new>
+#include <constexpr/assert.h>
+#include "type_info.h"
+#include "TypeOps.h"
+#include "alloc.h"
+#include "Span.h"
+#include "small_vector.h"
+
+namespace mem {
+    /**
+     * Runtime struct-of-arrays, one column per typeindex.
+     * All columns live in a single allocation, each starting on a 64 byte boundary
+     * so a column can be streamed or fed to SIMD loops without peeling.
+     * Rows are relocated with the column type's move/copy/destroy ops
+     */
+    template <
+        typename ReallocationSchema = doubling_schema,
+        typename size_type = size_t
+    >
+    class soa_vector {
+    public:
+        constexpr static size_t column_align = 64;
+        constexpr static size_t npos = static_cast<size_t>(-1);
+    private:
+        struct column {
+            typeindex type;
+            char* data = nullptr;
+        };
+
+        small_vector<column, 8> myColumns;
+        char* block = nullptr;
+        size_type current = 0;
+        size_type max = 0;
+        ReallocationSchema reallocSchema;
+
+        /* bytes needed for every column at capacity, columns padded to column_align */
+        size_t block_bytes(const size_type capacity) const {
+            size_t bytes = 0;
+            for (auto& col : myColumns) {
+                bytes = round_up_to_64(bytes);
+                bytes += col.type.stride() * capacity;
+            }
+            return bytes;
+        }
+
+        static void destroy(const typeindex type, void* at, const size_t count) {
+            if (!type.is_trivially_destructible() && count) {
+                type.destroy(at, count);
+            }
+        }
+
+        void destroy_all() {
+            for (auto& col : myColumns) {
+                destroy(col.type, col.data, current);
+            }
+        }
+
+        void deallocate() {
+            if (block) {
+                raw_delete(block, column_align);
+                block = nullptr;
+            }
+        }
+
+        void realloc(const size_type newCapacity) {
+            cexpr::require(newCapacity >= current);
+
+            char* newBlock = static_cast<char*>(raw_alloc(std::max<size_t>(block_bytes(newCapacity), 1), column_align));
+            size_t offset = 0;
+
+            for (auto& col : myColumns) {
+                offset = round_up_to_64(offset);
+                char* dst = newBlock + offset;
+
+                if (current) {
+                    col.type.move(dst, col.data, current);
+                    destroy(col.type, col.data, current);
+                }
+                col.data = dst;
+                offset += col.type.stride() * newCapacity;
+            }
+
+            deallocate();
+            block = newBlock;
+            max = newCapacity;
+        }
+
+        void ensure_has_memory(const size_type required) {
+            if (current + required > max) [[unlikely]] {
+                realloc(static_cast<size_type>(reallocSchema.grow(max, required)));
+            }
+        }
+
+        template <typename T>
+        T* typed(const size_t columnIndex) {
+            cexpr::require(columnIndex < myColumns.size() && myColumns[columnIndex].type.template is<T>());
+            return reinterpret_cast<T*>(myColumns[columnIndex].data);
+        }
+
+        template <typename T>
+        const T* typed(const size_t columnIndex) const {
+            cexpr::require(columnIndex < myColumns.size() && myColumns[columnIndex].type.template is<T>());
+            return reinterpret_cast<const T*>(myColumns[columnIndex].data);
+        }
+
+        template <typename... Ts, size_t... Is>
+        void construct_row(const size_type row, std::index_sequence<Is...>, Ts&&... values) {
+            (new (typed<std::decay_t<Ts>>(Is) + row) std::decay_t<Ts>(std::forward<Ts>(values)), ...);
+        }
+    public:
+        soa_vector() = default;
+
+        soa_vector(const range<const typeindex> types, const size_t capacity = 0) {
+            for (auto& type : types) {
+                cexpr::require(type.align() <= column_align);
+                myColumns.emplace_back(type);
+            }
+            if (capacity) {
+                reserve(static_cast<size_type>(capacity));
+            }
+        }
+
+        soa_vector(std::initializer_list<typeindex> types, const size_t capacity = 0)
+        : soa_vector(range<const typeindex>{types.begin(), types.end()}, capacity) {}
+
+        soa_vector(const soa_vector&) = delete;
+        soa_vector& operator = (const soa_vector&) = delete;
+
+        soa_vector(soa_vector&& other) noexcept
+        : myColumns(std::move(other.myColumns)), block(other.block), current(other.current), max(other.max), reallocSchema(std::move(other.reallocSchema)) {
+            other.block = nullptr;
+            other.current = 0;
+            other.max = 0;
+        }
+
+        soa_vector& operator = (soa_vector&& other) noexcept {
+            if (this != &other) {
+                release();
+
+                myColumns = std::move(other.myColumns);
+                block = other.block;
+                current = other.current;
+                max = other.max;
+                reallocSchema = std::move(other.reallocSchema);
+
+                other.block = nullptr;
+                other.current = 0;
+                other.max = 0;
+            }
+            return *this;
+        }
+
+        ~soa_vector() {
+            release();
+        }
+
+        /* constructs one value per column, in column order */
+        template <typename... Ts>
+        size_type emplace_row(Ts&&... values) {
+            cexpr::require(sizeof...(Ts) == myColumns.size());
+            ensure_has_memory(1);
+
+            construct_row(current, std::index_sequence_for<Ts...>{}, std::forward<Ts>(values)...);
+            return current++;
+        }
+
+        /* values holds one pointer per column */
+        size_type copy_emplace_row(const void* const* values) {
+            ensure_has_memory(1);
+
+            for (size_t i = 0; i < myColumns.size(); ++i) {
+                auto& col = myColumns[i];
+                col.type.copy_construct(col.type.index(col.data, current), values[i]);
+            }
+            return current++;
+        }
+
+        size_type move_emplace_row(void* const* values) {
+            ensure_has_memory(1);
+
+            for (size_t i = 0; i < myColumns.size(); ++i) {
+                auto& col = myColumns[i];
+                col.type.move(col.type.index(col.data, current), values[i]);
+            }
+            return current++;
+        }
+
+        /* appends count rows without constructing them, the caller fills every column before reading */
+        size_type emplace_uninitialized(const size_type count) {
+            ensure_has_memory(count);
+
+            const size_type first = current;
+            current += count;
+            return first;
+        }
+
+        /* O(1) erase, the last row takes the place of the removed one */
+        void swap_remove(const size_type row) {
+            cexpr::require(row < current);
+            const size_type last = current - 1;
+
+            for (auto& col : myColumns) {
+                void* at = col.type.index(col.data, row);
+                void* back = col.type.index(col.data, last);
+
+                if (row != last) {
+                    destroy(col.type, at, 1);
+                    col.type.move(at, back);
+                }
+                destroy(col.type, back, 1);
+            }
+            current = last;
+        }
+
+        void pop_back() {
+            cexpr::require(current > 0);
+            swap_remove(current - 1);
+        }
+
+        void reserve(const size_type capacity) {
+            if (max < capacity) {
+                realloc(capacity);
+            }
+        }
+
+        void shrink_to_fit() {
+            if (current < max) {
+                if (current) realloc(current);
+                else release_memory();
+            }
+        }
+
+        void clear() {
+            destroy_all();
+            current = 0;
+        }
+
+        void release_memory() {
+            clear();
+            deallocate();
+
+            for (auto& col : myColumns) {
+                col.data = nullptr;
+            }
+            max = 0;
+        }
+
+        void release() {
+            release_memory();
+            myColumns.clear();
+        }
+
+        size_t find_column(const typeindex type) const {
+            for (size_t i = 0; i < myColumns.size(); ++i) {
+                if (myColumns[i].type == type) {
+                    return i;
+                }
+            }
+            return npos;
+        }
+
+        template <typename T>
+        size_t find_column() const {
+            return find_column(type_info_of<T>);
+        }
+
+        template <typename T>
+        range<T> column(const size_t columnIndex) {
+            return {typed<T>(columnIndex), current};
+        }
+
+        template <typename T>
+        range<const T> column(const size_t columnIndex) const {
+            return {typed<T>(columnIndex), current};
+        }
+
+        template <typename T>
+        range<T> column() {
+            return column<T>(find_column<T>());
+        }
+
+        template <typename T>
+        range<const T> column() const {
+            return column<T>(find_column<T>());
+        }
+
+        void* column_data(const size_t columnIndex) {
+            return myColumns[columnIndex].data;
+        }
+
+        const void* column_data(const size_t columnIndex) const {
+            return myColumns[columnIndex].data;
+        }
+
+        void* at(const size_t columnIndex, const size_type row) {
+            cexpr::require(row < current);
+            auto& col = myColumns[columnIndex];
+            return col.type.index(col.data, row);
+        }
+
+        const void* at(const size_t columnIndex, const size_type row) const {
+            cexpr::require(row < current);
+            auto& col = myColumns[columnIndex];
+            return col.type.index(col.data, row);
+        }
+
+        typeindex column_type(const size_t columnIndex) const {
+            return myColumns[columnIndex].type;
+        }
+
+        size_t columns() const { return myColumns.size(); }
+        size_type size() const { return current; }
+        size_type capacity() const { return max; }
+        bool empty() const { return !current; }
+    };
+}
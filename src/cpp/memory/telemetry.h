@@ -0,0 +1,289 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <oneapi/tbb/enumerable_thread_specific.h>
+
+/* Build with -DMEM_ALLOCATOR_TELEMETRY=1 to record allocator statistics, compiled out otherwise */
+#ifndef MEM_ALLOCATOR_TELEMETRY
+#define MEM_ALLOCATOR_TELEMETRY 0
+#endif
+
+/* lets the disabled telemetry member take no space, MSVC ignores the standard attribute to keep its ABI */
+#if defined(_MSC_VER)
+#define MEM_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define MEM_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+namespace mem {
+    constexpr static bool is_telemetry_enabled = MEM_ALLOCATOR_TELEMETRY != 0;
+
+    /**
+     * What an allocator reports about its backing memory when sampled,
+     * byte_arena, free_list_allocator and atomic_byte_arena expose it through usage()
+     */
+    struct allocator_usage {
+        size_t bytesUsed = 0;
+        size_t capacityBytes = 0;
+        size_t blocks = 0;
+        size_t largestFreeBlock = 0;
+
+        size_t freeBytes() const {
+            return capacityBytes - bytesUsed;
+        }
+
+        allocator_usage& operator += (const allocator_usage& other) {
+            bytesUsed += other.bytesUsed;
+            capacityBytes += other.capacityBytes;
+            blocks += other.blocks;
+            largestFreeBlock = std::max(largestFreeBlock, other.largestFreeBlock);
+            return *this;
+        }
+    };
+
+    template <typename Allocator>
+    concept IsTelemetrySampleable = requires(const Allocator& allocator) {
+        { allocator.usage() } -> std::convertible_to<allocator_usage>;
+    };
+
+    struct allocator_stats {
+        const char* owner = "";
+        size_t frames = 0;
+
+        /* last completed frame */
+        size_t allocations = 0;
+        size_t frameBytes = 0;
+        size_t capacityBytes = 0;
+        size_t blocks = 0;
+        size_t freeBytes = 0;
+        size_t largestFreeBlock = 0;
+
+        /* high-water marks since creation */
+        size_t peakFrameBytes = 0;
+        size_t peakCapacityBytes = 0;
+        size_t peakBlocks = 0;
+
+        /* 0 when all free memory is one contiguous block, approaches 1 as it splinters */
+        double fragmentation() const {
+            if (!freeBytes) return 0.0;
+            return 1.0 - static_cast<double>(largestFreeBlock) / static_cast<double>(freeBytes);
+        }
+
+        double utilization() const {
+            if (!capacityBytes) return 0.0;
+            return static_cast<double>(capacityBytes - freeBytes) / static_cast<double>(capacityBytes);
+        }
+
+        static void write_csv_header(std::ostream& os) {
+            os << "owner,frames,allocations,frame_bytes,peak_frame_bytes,capacity_bytes,peak_capacity_bytes,"
+                  "blocks,peak_blocks,free_bytes,largest_free_block,fragmentation\n";
+        }
+
+        void write_csv(std::ostream& os) const {
+            os << owner << ',' << frames << ',' << allocations << ','
+               << frameBytes << ',' << peakFrameBytes << ','
+               << capacityBytes << ',' << peakCapacityBytes << ','
+               << blocks << ',' << peakBlocks << ','
+               << freeBytes << ',' << largestFreeBlock << ','
+               << fragmentation() << '\n';
+        }
+    };
+
+    /**
+     * Lock-free per-owner counters, record_allocation may be called from any thread,
+     * end_frame is expected from the thread that resets the owning allocator
+     */
+    class allocator_counters {
+        static void store_max(std::atomic<size_t>& dst, const size_t value) {
+            size_t current = dst.load(std::memory_order_relaxed);
+            while (current < value && !dst.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+        }
+
+        /* running totals of one thread, only that thread writes them so counting needs no read-modify-write */
+        struct alignas(64) thread_counts {
+            std::atomic<size_t> allocations = 0;
+            std::atomic<size_t> bytes = 0;
+        };
+
+        const char* owner;
+
+        tbb::enumerable_thread_specific<thread_counts> threadCounts;
+
+        /* sum of every thread's totals at the last end_frame */
+        size_t foldedAllocations = 0;
+        size_t foldedBytes = 0;
+
+        alignas(64) std::atomic<size_t> frames = 0;
+        std::atomic<size_t> allocations = 0;
+        std::atomic<size_t> frameBytes = 0;
+        std::atomic<size_t> capacityBytes = 0;
+        std::atomic<size_t> blocks = 0;
+        std::atomic<size_t> freeBytes = 0;
+        std::atomic<size_t> largestFreeBlock = 0;
+
+        std::atomic<size_t> peakFrameBytes = 0;
+        std::atomic<size_t> peakCapacityBytes = 0;
+        std::atomic<size_t> peakBlocks = 0;
+    public:
+        explicit allocator_counters(const char* owner) : owner(owner) {}
+
+        void record_allocation(const size_t bytes) {
+            auto& local = threadCounts.local();
+            local.allocations.store(local.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            local.bytes.store(local.bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        }
+
+        /* folds the per-thread totals, the frame's share is what they grew by since the previous fold */
+        void end_frame(const allocator_usage& usage) {
+            size_t totalAllocations = 0;
+            size_t totalBytes = 0;
+
+            for (const auto& local : threadCounts) {
+                totalAllocations += local.allocations.load(std::memory_order_relaxed);
+                totalBytes += local.bytes.load(std::memory_order_relaxed);
+            }
+
+            const size_t bytes = totalBytes - foldedBytes;
+
+            allocations.store(totalAllocations - foldedAllocations, std::memory_order_relaxed);
+            frameBytes.store(bytes, std::memory_order_relaxed);
+            foldedAllocations = totalAllocations;
+            foldedBytes = totalBytes;
+            capacityBytes.store(usage.capacityBytes, std::memory_order_relaxed);
+            blocks.store(usage.blocks, std::memory_order_relaxed);
+            freeBytes.store(usage.freeBytes(), std::memory_order_relaxed);
+            largestFreeBlock.store(usage.largestFreeBlock, std::memory_order_relaxed);
+
+            store_max(peakFrameBytes, bytes);
+            store_max(peakCapacityBytes, usage.capacityBytes);
+            store_max(peakBlocks, usage.blocks);
+
+            frames.fetch_add(1, std::memory_order_release);
+        }
+
+        allocator_stats stats() const {
+            allocator_stats stats;
+            stats.owner = owner;
+            stats.frames = frames.load(std::memory_order_acquire);
+            stats.allocations = allocations.load(std::memory_order_relaxed);
+            stats.frameBytes = frameBytes.load(std::memory_order_relaxed);
+            stats.capacityBytes = capacityBytes.load(std::memory_order_relaxed);
+            stats.blocks = blocks.load(std::memory_order_relaxed);
+            stats.freeBytes = freeBytes.load(std::memory_order_relaxed);
+            stats.largestFreeBlock = largestFreeBlock.load(std::memory_order_relaxed);
+            stats.peakFrameBytes = peakFrameBytes.load(std::memory_order_relaxed);
+            stats.peakCapacityBytes = peakCapacityBytes.load(std::memory_order_relaxed);
+            stats.peakBlocks = peakBlocks.load(std::memory_order_relaxed);
+            return stats;
+        }
+    };
+
+    class telemetry_registry {
+        std::mutex mutex;
+        std::vector<const allocator_counters*> counters;
+    public:
+        static telemetry_registry& get() {
+            static telemetry_registry registry;
+            return registry;
+        }
+
+        void add(const allocator_counters* entry) {
+            std::lock_guard lock(mutex);
+            counters.push_back(entry);
+        }
+
+        void remove(const allocator_counters* entry) {
+            std::lock_guard lock(mutex);
+            std::erase(counters, entry);
+        }
+
+        std::vector<allocator_stats> snapshot() {
+            std::lock_guard lock(mutex);
+            std::vector<allocator_stats> stats;
+            stats.reserve(counters.size());
+
+            for (auto* entry : counters) {
+                stats.push_back(entry->stats());
+            }
+            return stats;
+        }
+
+        void write_csv(std::ostream& os) {
+            allocator_stats::write_csv_header(os);
+
+            for (auto& stats : snapshot()) {
+                stats.write_csv(os);
+            }
+        }
+    };
+
+    /**
+     * Member of an allocator owner, tagged with the owner's name and declared MEM_NO_UNIQUE_ADDRESS.
+     * Empty and every call a no-op unless MEM_ALLOCATOR_TELEMETRY is set
+     */
+    template <bool Enabled = is_telemetry_enabled>
+    class basic_allocator_telemetry {
+    public:
+        basic_allocator_telemetry() = default;
+        explicit basic_allocator_telemetry(const char*) {}
+
+        void record_allocation(size_t) {}
+
+        void end_frame(const allocator_usage&) {}
+
+        template <IsTelemetrySampleable... Allocators>
+        void end_frame(const Allocators&...) {}
+
+        allocator_stats stats() const { return {}; }
+    };
+
+    template <>
+    class basic_allocator_telemetry<true> {
+        std::unique_ptr<allocator_counters> counters;
+    public:
+        basic_allocator_telemetry() : basic_allocator_telemetry("unnamed") {}
+
+        explicit basic_allocator_telemetry(const char* owner) : counters(std::make_unique<allocator_counters>(owner)) {
+            telemetry_registry::get().add(counters.get());
+        }
+
+        basic_allocator_telemetry(basic_allocator_telemetry&&) noexcept = default;
+        basic_allocator_telemetry& operator = (basic_allocator_telemetry&& other) noexcept {
+            if (this != &other) {
+                if (counters) telemetry_registry::get().remove(counters.get());
+                counters = std::move(other.counters);
+            }
+            return *this;
+        }
+
+        ~basic_allocator_telemetry() {
+            if (counters) telemetry_registry::get().remove(counters.get());
+        }
+
+        void record_allocation(const size_t bytes) {
+            counters->record_allocation(bytes);
+        }
+
+        void end_frame(const allocator_usage& usage) {
+            counters->end_frame(usage);
+        }
+
+        template <IsTelemetrySampleable... Allocators>
+        void end_frame(const Allocators&... allocators) {
+            allocator_usage usage;
+            ((usage += allocators.usage()), ...);
+            counters->end_frame(usage);
+        }
+
+        /* a moved-from telemetry reports nothing */
+        allocator_stats stats() const {
+            return counters ? counters->stats() : allocator_stats{};
+        }
+    };
+
+    using allocator_telemetry = basic_allocator_telemetry<>;
+}
@@ -81,6 +81,8 @@ namespace mem {
         size_t align = 0;
 
         CopyFn copy = 0;
+        /* like copy but constructs into uninitialized memory */
+        CopyFn copyConstruct = 0;
         MoveFn move = 0;
         DestructorFn destruct = 0;
         SwapFn swap = 0;
@@ -144,6 +146,21 @@ namespace mem {
                         };
                     }
 
+                    if constexpr (!std::is_trivially_copy_constructible_v<T>) {
+                        type.copyConstruct = [](void* dst, const void* src, size_t count) {
+                            T* dstT = static_cast<T*>(dst);
+                            const T* srcT = static_cast<const T*>(src);
+
+                            if constexpr (std::is_copy_constructible_v<T>) {
+                                for (size_t i = 0; i < count; ++i) {
+                                    new (dstT + i) T(srcT[i]);
+                                }
+                            } else {
+                                cexpr::require(false);
+                            }
+                        };
+                    }
+
                     if constexpr (!std::is_trivially_move_constructible_v<T>) {
                         type.move = [](void* dst, void* src, size_t count) {
                             T* dstT = static_cast<T*>(dst);
@@ -191,6 +208,7 @@ namespace mem {
         constexpr bool is_trivially_destructible() const { return type->is_trivially_destructible(); }
         constexpr bool is_trivially_copyable() const { return type->copy == nullptr; }
         constexpr bool is_trivially_moveable() const { return type->move == nullptr; }
+        constexpr bool is_trivially_copy_constructible() const { return type->copyConstruct == nullptr; }
 
         constexpr bool operator == (const typeindex& other) const { return type->typeHash == other.type->typeHash; }
         constexpr bool operator != (const typeindex& other) const { return type->typeHash != other.type->typeHash; }
@@ -210,6 +228,12 @@ namespace mem {
             else type->copy(dst, src, count);
         }
 
+        /* dst is uninitialized memory */
+        constexpr void copy_construct(void* dst, const void* src, size_t count = 1) const {
+            if (is_trivially_copy_constructible()) std::memcpy(dst, src, type->size * count);
+            else type->copyConstruct(dst, src, count);
+        }
+
         constexpr void move(void* dst, void* src, size_t count = 1) const {
             if (is_trivially_moveable()) std::memcpy(dst, src, type->size * count);
             else type->move(dst, src, count);